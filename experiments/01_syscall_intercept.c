@@ -3,6 +3,8 @@
 #include <linux/init.h>
 #include <linux/kprobes.h>
 #include <linux/sched.h>
+#include <linux/workqueue.h>
+#include <linux/ratelimit.h>
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Student");
@@ -11,16 +13,42 @@ MODULE_VERSION("1.0");
 
 static struct kprobe kp_fork;
 static struct kprobe kp_exit;
-static unsigned long fork_count = 0;
-static unsigned long exit_count = 0;
+static atomic_long_t fork_count = ATOMIC_LONG_INIT(0);
+static atomic_long_t exit_count = ATOMIC_LONG_INIT(0);
+static atomic_long_t suppressed_count = ATOMIC_LONG_INIT(0);
+
+static bool verbose_events = false;
+module_param(verbose_events, bool, 0644);
+MODULE_PARM_DESC(verbose_events, "Log every fork/exit event, rate limited (default off)");
+static unsigned int summary_interval = 10;
+module_param(summary_interval, uint, 0644);
+MODULE_PARM_DESC(summary_interval, "Seconds between event summaries, 0 disables (default 10)");
+static DEFINE_RATELIMIT_STATE(event_ratelimit, 5 * HZ, 10);
+
+static void summary_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(summary_work, summary_work_fn);
+static unsigned long last_forks, last_exits, last_summary;
+
+/* Returns 1 when a per-event message may be printed */
+static int event_log_allowed(void)
+{
+    if (!verbose_events)
+        return 0;
+    if (!__ratelimit(&event_ratelimit)) {
+        atomic_long_inc(&suppressed_count);
+        return 0;
+    }
+    return 1;
+}
 
 static int pre_handler_fork(struct kprobe *p, struct pt_regs *regs)
 {
     struct task_struct *task = current;
-    fork_count++;
+    long forks = atomic_long_inc_return(&fork_count);
     
-    printk(KERN_INFO "syscall_intercept: FORK detected - PID: %d, PPID: %d, COMM: %s, Total forks: %lu\n",
-           task->pid, task->parent->pid, task->comm, fork_count);
+    if (event_log_allowed())
+        printk(KERN_INFO "syscall_intercept: FORK detected - PID: %d, PPID: %d, COMM: %s, Total forks: %ld\n",
+               task->pid, task->parent->pid, task->comm, forks);
     
     return 0;
 }
@@ -28,14 +56,36 @@ static int pre_handler_fork(struct kprobe *p, struct pt_regs *regs)
 static int pre_handler_exit(struct kprobe *p, struct pt_regs *regs)
 {
     struct task_struct *task = current;
-    exit_count++;
+    long exits = atomic_long_inc_return(&exit_count);
     
-    printk(KERN_INFO "syscall_intercept: EXIT detected - PID: %d, COMM: %s, Total exits: %lu\n",
-           task->pid, task->comm, exit_count);
+    if (event_log_allowed())
+        printk(KERN_INFO "syscall_intercept: EXIT detected - PID: %d, COMM: %s, Total exits: %ld\n",
+               task->pid, task->comm, exits);
     
     return 0;
 }
 
+/* Periodic replacement for per-event logging: counts and rates per interval */
+static void summary_work_fn(struct work_struct *work)
+{
+    unsigned long forks = atomic_long_read(&fork_count);
+    unsigned long exits = atomic_long_read(&exit_count);
+    unsigned long seconds = max_t(unsigned long, (jiffies - last_summary) / HZ, 1);
+    long suppressed = atomic_long_xchg(&suppressed_count, 0);
+    
+    /* With summaries off the work keeps polling so re-enabling takes effect */
+    if (summary_interval && (forks != last_forks || exits != last_exits || suppressed))
+        printk(KERN_INFO "syscall_intercept: last %lus - forks: %lu (%lu/s), exits: %lu (%lu/s), suppressed: %ld\n",
+               seconds, forks - last_forks, (forks - last_forks) / seconds,
+               exits - last_exits, (exits - last_exits) / seconds, suppressed);
+    
+    last_forks = forks;
+    last_exits = exits;
+    last_summary = jiffies;
+    
+    schedule_delayed_work(&summary_work, (summary_interval ? summary_interval : 10) * HZ);
+}
+
 static int __init syscall_intercept_init(void)
 {
     int ret;
@@ -69,8 +119,12 @@ static int __init syscall_intercept_init(void)
     }
     printk(KERN_INFO "syscall_intercept: Exit kprobe registered successfully\n");
     
-    printk(KERN_INFO "syscall_intercept: Module loaded! Watch dmesg for process events\n");
-    printk(KERN_INFO "syscall_intercept: Use 'dmesg | tail -f' to see real-time events\n");
+    ratelimit_set_flags(&event_ratelimit, RATELIMIT_MSG_ON_RELEASE);
+    last_summary = jiffies;
+    schedule_delayed_work(&summary_work, (summary_interval ? summary_interval : 10) * HZ);
+    
+    printk(KERN_INFO "syscall_intercept: Module loaded! Watch dmesg for process event summaries\n");
+    printk(KERN_INFO "syscall_intercept: Load with verbose_events=1 for rate-limited per-event lines\n");
     
     return 0;
 }
@@ -81,10 +135,11 @@ static void __exit syscall_intercept_exit(void)
     
     unregister_kprobe(&kp_fork);
     unregister_kprobe(&kp_exit);
+    cancel_delayed_work_sync(&summary_work);
     
     printk(KERN_INFO "syscall_intercept: Final statistics:\n");
-    printk(KERN_INFO "syscall_intercept: Total fork events: %lu\n", fork_count);
-    printk(KERN_INFO "syscall_intercept: Total exit events: %lu\n", exit_count);
+    printk(KERN_INFO "syscall_intercept: Total fork events: %ld\n", atomic_long_read(&fork_count));
+    printk(KERN_INFO "syscall_intercept: Total exit events: %ld\n", atomic_long_read(&exit_count));
     printk(KERN_INFO "syscall_intercept: Module unloaded successfully\n");
 }
 
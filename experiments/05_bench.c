@@ -0,0 +1,452 @@
+/*
+ * Fork/exit overhead benchmark for 05_complete_monitor.
+ *
+ * Runs fork+exit, vfork+exec and pthread_create+join loops on 1..N worker
+ * threads pinned to separate CPUs for a fixed time, and reports throughput
+ * and per-operation latency percentiles. Given the module with -m, it runs
+ * every case with the module unloaded and then loaded, and prints what the
+ * module adds per operation and per captured event. With -b it loads the
+ * module once per capture backend, which compares the backends including
+ * the kprobe trap and tracepoint dispatch no in-module timer can see.
+ *
+ * Build: gcc -O2 -pthread -o 05_bench 05_bench.c
+ * Usage: sudo ./05_bench [-m 05_complete_monitor.ko [-b kprobe,tracepoint]]
+ *                        [-d seconds] [-t max_threads]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define PROC_BASE "/proc/process_monitor_complete"
+#define MODULE_NAME "05_complete_monitor"
+#define EXEC_MARKER "--bench-exit"
+#define MAX_WORKERS 256
+#define MAX_BACKENDS 2
+#define WARMUP_OPS 50
+
+/* Same log-linear layout as the module's lifetime histogram */
+#define HIST_SUB_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+enum workload {
+    WL_FORK_EXIT,
+    WL_VFORK_EXEC,
+    WL_THREAD,
+    WL_COUNT,
+};
+
+static const char *workload_names[WL_COUNT] = { "fork+exit", "vfork+exec", "pthread" };
+
+/* Events the monitor captures per operation: fork and exit, plus exec */
+static const int workload_events[WL_COUNT] = { 2, 3, 2 };
+
+struct histogram {
+    unsigned long long count;
+    unsigned long long sum_ns;
+    unsigned long long buckets[HIST_BUCKETS];
+};
+
+struct worker {
+    pthread_t thread;
+    int cpu;
+    enum workload wl;
+    struct histogram hist;
+    int failed;
+};
+
+struct result {
+    double ops_per_sec;
+    double mean_ns;
+    unsigned long long p50, p99, p999;
+    int valid;
+};
+
+static volatile int stop_flag;
+static volatile int start_flag;
+static char self_path[4096];
+/* Pass 0 runs unloaded, pass 1 + i with backends[i] */
+static struct result results[1 + MAX_BACKENDS][WL_COUNT][MAX_WORKERS + 1];
+static char *backends[MAX_BACKENDS];
+static int nr_backends;
+
+static unsigned int hist_bucket(unsigned long long ns) {
+    if (ns < HIST_SUB_BUCKETS)
+        return ns;
+    
+    unsigned int shift = 63 - __builtin_clzll(ns) - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB_BUCKETS + ((ns >> shift) & (HIST_SUB_BUCKETS - 1));
+}
+
+static unsigned long long hist_value(unsigned int idx) {
+    if (idx < HIST_SUB_BUCKETS)
+        return idx;
+    
+    unsigned int shift = idx / HIST_SUB_BUCKETS - 1;
+    unsigned long long low = (unsigned long long)(HIST_SUB_BUCKETS + idx % HIST_SUB_BUCKETS) << shift;
+    return low + ((1ULL << shift) >> 1);
+}
+
+static unsigned long long hist_percentile(const struct histogram *h, double pct) {
+    unsigned long long target = (unsigned long long)(h->count * pct / 100.0);
+    unsigned long long seen = 0;
+    
+    if (target >= h->count)
+        target = h->count - 1;
+    
+    for (unsigned int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen > target)
+            return hist_value(i);
+    }
+    return 0;
+}
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *noop_thread(void *arg) {
+    return arg;
+}
+
+/* One operation of the workload; returns 0 on success */
+static int run_op(enum workload wl) {
+    pid_t pid;
+    int status;
+    
+    switch (wl) {
+    case WL_FORK_EXIT:
+        pid = fork();
+        if (pid == 0)
+            _exit(0);
+        if (pid < 0)
+            return -1;
+        return waitpid(pid, &status, 0) == pid ? 0 : -1;
+    
+    case WL_VFORK_EXEC: {
+        char *argv[] = { self_path, EXEC_MARKER, NULL };
+        char *envp[] = { NULL };
+        
+        pid = vfork();
+        if (pid == 0) {
+            execve(self_path, argv, envp);
+            _exit(127);
+        }
+        if (pid < 0)
+            return -1;
+        return waitpid(pid, &status, 0) == pid ? 0 : -1;
+    }
+    
+    case WL_THREAD: {
+        pthread_t t;
+        
+        if (pthread_create(&t, NULL, noop_thread, NULL) != 0)
+            return -1;
+        return pthread_join(t, NULL);
+    }
+    
+    default:
+        return -1;
+    }
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    cpu_set_t set;
+    
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    
+    for (int i = 0; i < WARMUP_OPS; i++)
+        run_op(w->wl);
+    
+    while (!start_flag)
+        sched_yield();
+    
+    while (!stop_flag) {
+        unsigned long long t0 = now_ns();
+        if (run_op(w->wl) != 0) {
+            w->failed++;
+            continue;
+        }
+        unsigned long long dt = now_ns() - t0;
+        
+        w->hist.count++;
+        w->hist.sum_ns += dt;
+        w->hist.buckets[hist_bucket(dt)]++;
+    }
+    
+    return NULL;
+}
+
+static struct result run_case(enum workload wl, int nthreads, int seconds, int ncpus) {
+    static struct worker workers[MAX_WORKERS];
+    static struct histogram total;
+    struct result r = {0};
+    int failed = 0;
+    
+    memset(workers, 0, sizeof(workers));
+    memset(&total, 0, sizeof(total));
+    stop_flag = 0;
+    start_flag = 0;
+    
+    for (int i = 0; i < nthreads; i++) {
+        workers[i].cpu = i % ncpus;
+        workers[i].wl = wl;
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+            perror("pthread_create");
+            nthreads = i;
+            break;
+        }
+    }
+    
+    unsigned long long t0 = now_ns();
+    start_flag = 1;
+    sleep(seconds);
+    stop_flag = 1;
+    
+    for (int i = 0; i < nthreads; i++)
+        pthread_join(workers[i].thread, NULL);
+    double elapsed = (now_ns() - t0) / 1e9;
+    
+    for (int i = 0; i < nthreads; i++) {
+        total.count += workers[i].hist.count;
+        total.sum_ns += workers[i].hist.sum_ns;
+        for (int b = 0; b < HIST_BUCKETS; b++)
+            total.buckets[b] += workers[i].hist.buckets[b];
+        failed += workers[i].failed;
+    }
+    
+    if (failed)
+        printf("  (%d failed operations ignored)\n", failed);
+    if (!total.count)
+        return r;
+    
+    r.ops_per_sec = total.count / elapsed;
+    r.mean_ns = (double)total.sum_ns / total.count;
+    r.p50 = hist_percentile(&total, 50.0);
+    r.p99 = hist_percentile(&total, 99.0);
+    r.p999 = hist_percentile(&total, 99.9);
+    r.valid = 1;
+    return r;
+}
+
+static int module_loaded(void) {
+    struct stat st;
+    return stat(PROC_BASE, &st) == 0;
+}
+
+/* Run argv[0] from PATH without a shell; 0 if it exited with status 0 */
+static int run_command(char *const argv[]) {
+    int status;
+    pid_t pid = fork();
+    
+    if (pid < 0)
+        return -1;
+    if (pid == 0) {
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    if (waitpid(pid, &status, 0) < 0)
+        return -1;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+/*
+ * Load with the capture governor off: the loaded pass forks far faster
+ * than its default threshold and would otherwise be measured sampling
+ * or counting only. backend NULL keeps the module's default.
+ */
+static int set_module(const char *ko, int load, const char *backend) {
+    char param[64];
+    char *insmod[] = { "insmod", (char *)ko, "governor_threshold=0", "governor_count_only=0",
+                       NULL, NULL };
+    char *rmmod[] = { "rmmod", MODULE_NAME, NULL };
+    
+    if (backend) {
+        snprintf(param, sizeof(param), "capture_backend=%s", backend);
+        insmod[4] = param;
+    }
+    
+    if (run_command(load ? insmod : rmmod) != 0 || module_loaded() != load) {
+        fprintf(stderr, "Failed to %s the module (%s)\n", load ? "load" : "unload", ko);
+        return -1;
+    }
+    return 0;
+}
+
+/* Print the governor mode from the stats file, to confirm full capture */
+static void print_governor_mode(void) {
+    char line[256];
+    int in_governor = 0;
+    FILE *f = fopen(PROC_BASE "/stats", "r");
+    
+    if (!f)
+        return;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "=== ", 4) == 0)
+            in_governor = strstr(line, "Capture Governor") != NULL;
+        else if (in_governor && strncmp(line, "Mode:", 5) == 0)
+            printf("Capture governor after the pass: %s", line + 6);
+    }
+    fclose(f);
+}
+
+/* Thread counts 1, 2, 4, ... and finally max; 0 when done */
+static int next_thread_count(int n, int max) {
+    if (n >= max)
+        return 0;
+    return n * 2 < max ? n * 2 : max;
+}
+
+static void run_pass(int pass, const char *backend, int seconds, int max_threads, int ncpus) {
+    if (!pass)
+        printf("\n=== Module UNLOADED ===\n");
+    else if (backend)
+        printf("\n=== Module LOADED, %s backend ===\n", backend);
+    else
+        printf("\n=== Module LOADED ===\n");
+    printf("%-11s %-8s %-12s %-10s %-10s %-10s %-10s\n",
+           "WORKLOAD", "THREADS", "OPS/SEC", "MEAN_NS", "P50_NS", "P99_NS", "P999_NS");
+    
+    for (int wl = 0; wl < WL_COUNT; wl++) {
+        for (int n = 1; n; n = next_thread_count(n, max_threads)) {
+            struct result *r = &results[pass][wl][n];
+            
+            *r = run_case(wl, n, seconds, ncpus);
+            if (r->valid) {
+                printf("%-11s %-8d %-12.0f %-10.0f %-10llu %-10llu %-10llu\n",
+                       workload_names[wl], n, r->ops_per_sec, r->mean_ns, r->p50, r->p99, r->p999);
+            }
+            fflush(stdout);
+        }
+    }
+}
+
+static void print_overhead(int pass, const char *backend, int max_threads) {
+    if (backend)
+        printf("\n=== Module Overhead, %s backend (loaded - unloaded) ===\n", backend);
+    else
+        printf("\n=== Module Overhead (loaded - unloaded) ===\n");
+    printf("%-11s %-8s %-12s %-12s %-12s %-14s\n",
+           "WORKLOAD", "THREADS", "THROUGHPUT", "MEAN_NS/OP", "P99_NS/OP", "MEAN_NS/EVENT");
+    
+    for (int wl = 0; wl < WL_COUNT; wl++) {
+        for (int n = 1; n <= max_threads; n++) {
+            struct result *a = &results[0][wl][n];
+            struct result *b = &results[pass][wl][n];
+            
+            if (!a->valid || !b->valid)
+                continue;
+            
+            double delta = b->mean_ns - a->mean_ns;
+            printf("%-11s %-8d %+-11.1f%% %-+12.0f %-+12lld %-+14.0f\n",
+                   workload_names[wl], n, (b->ops_per_sec / a->ops_per_sec - 1.0) * 100.0,
+                   delta, (long long)b->p99 - (long long)a->p99, delta / workload_events[wl]);
+        }
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-m module.ko [-b backends]] [-d seconds] [-t max_threads]\n", prog);
+    fprintf(stderr, "  -m  run unloaded and loaded passes, (un)loading this module (needs root)\n");
+    fprintf(stderr, "  -b  comma-separated capture backends, one loaded pass each\n"
+                    "      (kprobe, tracepoint; default: the module's default)\n");
+    fprintf(stderr, "  -d  seconds per case (default 5)\n");
+    fprintf(stderr, "  -t  largest worker thread count (default: online CPUs)\n");
+}
+
+int main(int argc, char *argv[]) {
+    /* Child side of the vfork+exec workload */
+    if (argc > 1 && strcmp(argv[1], EXEC_MARKER) == 0)
+        _exit(0);
+    
+    int ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int seconds = 5;
+    int max_threads = ncpus;
+    const char *ko = NULL;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "m:b:d:t:h")) != -1) {
+        switch (opt) {
+        case 'm':
+            ko = optarg;
+            break;
+        case 'b':
+            nr_backends = 0;
+            for (char *b = strtok(optarg, ","); b; b = strtok(NULL, ",")) {
+                if (nr_backends == MAX_BACKENDS ||
+                    (strcmp(b, "kprobe") != 0 && strcmp(b, "tracepoint") != 0)) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                backends[nr_backends++] = b;
+            }
+            break;
+        case 'd':
+            seconds = atoi(optarg);
+            break;
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    
+    if (seconds < 1 || max_threads < 1 || max_threads > MAX_WORKERS) {
+        usage(argv[0]);
+        return 1;
+    }
+    
+    ssize_t len = readlink("/proc/self/exe", self_path, sizeof(self_path) - 1);
+    if (len < 0) {
+        perror("readlink /proc/self/exe");
+        return 1;
+    }
+    self_path[len] = '\0';
+    
+    printf("=== Process Monitor Overhead Benchmark ===\n");
+    printf("CPUs: %d, threads: 1..%d, %d s per case\n", ncpus, max_threads, seconds);
+    
+    if (!ko) {
+        printf("No module given (-m), single pass with the module %s\n",
+               module_loaded() ? "loaded" : "unloaded");
+        run_pass(module_loaded(), NULL, seconds, max_threads, ncpus);
+        if (module_loaded())
+            print_governor_mode();
+        return 0;
+    }
+    
+    if (module_loaded() && set_module(ko, 0, NULL) < 0)
+        return 1;
+    run_pass(0, NULL, seconds, max_threads, ncpus);
+    
+    if (!nr_backends)
+        nr_backends = 1;
+    for (int i = 0; i < nr_backends; i++) {
+        if (set_module(ko, 1, backends[i]) < 0)
+            return 1;
+        run_pass(1 + i, backends[i], seconds, max_threads, ncpus);
+        print_governor_mode();
+        if (set_module(ko, 0, NULL) < 0)
+            return 1;
+    }
+    
+    for (int i = 0; i < nr_backends; i++)
+        print_overhead(1 + i, backends[i], max_threads);
+    return 0;
+}
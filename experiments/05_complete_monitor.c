@@ -1,20 +1,48 @@
 #include <linux/module.h>
+#include <linux/version.h>
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/sched.h>
 #include <linux/sched/signal.h>
+#include <linux/sched/cputime.h>
+#include <linux/sched/task.h>
 #include <linux/kprobes.h>
+#include <linux/tracepoint.h>
+#include <linux/binfmts.h>
 #include <linux/slab.h>
+#include <linux/mempool.h>
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
 #include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/seqlock.h>
 #include <linux/time.h>
 #include <linux/uaccess.h>
 #include <linux/string.h>
+#include <linux/rhashtable.h>
+#include <linux/xarray.h>
 #include <linux/hashtable.h>
-#include <linux/rbtree.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/sort.h>
+#include <linux/ratelimit.h>
+#include <linux/math64.h>
+#include <linux/cred.h>
+#include <linux/uidgid.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
+#include <linux/jump_label.h>
+#include <linux/hash.h>
+#include <net/genetlink.h>
+
+#include "process_monitor_uapi.h"
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Student");
@@ -22,33 +50,218 @@ MODULE_DESCRIPTION("Experiment 5: Complete Process Monitoring System");
 MODULE_VERSION("1.0");
 
 #define PROC_DIR_NAME "process_monitor_complete"
-#define MAX_PROCESS_RECORDS 1000
-#define PROCESS_HASH_BITS 8
+#define MAX_PROCESS_RECORDS 1000        /* default capacity */
+#define MAX_RECORD_CAPACITY (1 << 20)
+#define RECORD_POOL_RESERVE 4096
+#define RECORD_CACHE_NAME "complete_monitor_record"
+#define EXTRA_CACHE_NAME "complete_monitor_extra"
+#define RECORD_SIZE_MAX 80              /* sizeof(struct process_record) on 64-bit */
+#define STAGING_BUFFER_SIZE 1024        /* events per CPU, power of two */
+#define STAGING_KICK_THRESHOLD 512      /* wake the drain worker early at this fill level */
+#define STAGING_DRAIN_INTERVAL_MS 100
+#define DRAIN_BATCH_MAX 4096
+#define DEFERRED_EXITS_MAX 1024         /* unmatched exits retried on the next drain */
+#define SUMMARY_TOP_SLOTS 32            /* distinct commands tracked per summary interval */
+#define SUMMARY_TOP_SHOWN 5
+#define LIVE_FOLD_BATCH 32              /* per-CPU live count drift before folding */
+#define PROCESSES_END_TOKEN ((void *)2) /* footer row of the processes file */
+#define RECORD_RUNNING PM_RECORD_RUNNING /* lifetime_ms of a record not yet exited */
+#define COMM_HASH_BITS 9
+#define COMM_ID_MAX U16_MAX
+#define RULE_PID_MIN_BITS 1024
+#define RULE_COMM_MIN_SLOTS 64
+#define FILTER_WRITE_MAX (16 * 1024)     /* bulk rule loads per write() */
+#define LIFETIME_SUB_BITS 4             /* 16 linear steps per power of two, <= 6.25% error */
+#define LIFETIME_SUB_BUCKETS (1 << LIFETIME_SUB_BITS)
+#define LIFETIME_BUCKETS ((64 - LIFETIME_SUB_BITS + 1) * LIFETIME_SUB_BUCKETS)
+#define EVENT_RING_MIN_EVENTS 64
+#define EVENT_RING_MAX_EVENTS (1 << 20)
+#define NETLINK_BATCH_MAX 128           /* events per netlink message */
+#define SNAPSHOT_CHUNK 64               /* records copied per RCU section */
+#define GOVERNOR_MAX_SHIFT 10          /* sample no sparser than 1 in 1024 */
+#define SELFPROF_BUCKETS ((32 - LIFETIME_SUB_BITS + 1) * LIFETIME_SUB_BUCKETS) /* up to ~4s */
+#define TREE_BRANCHES_MAX 32            /* direct children summarised by the tree file */
+#define TREE_LIST_MAX 256               /* subtree members listed by the tree file */
+#define TREE_DEPTH_MAX 128              /* levels the tree file descends */
+#define TOPCOMM_SLOTS 64                /* counters in the heavy-hitter sketch */
+#define TOPCOMM_HASH_SIZE 128
+#define TOPCOMM_NONE 0xff
+#define USAGE_COMM_BITS 7
+#define USAGE_COMMS_MAX 512             /* commands with their own usage sums */
+#define USAGE_TOP_SHOWN 8
+#define RATE_HISTORY_SECS 300           /* per-second samples kept */
+#define RATE_FSHIFT 16                  /* fixed point of the rate averages */
+#define RATE_FIXED_1 (1 << RATE_FSHIFT)
+#define RATE_EXP_1 64453                /* 1/exp(1s/1min) */
+#define RATE_EXP_5 65318                /* 1/exp(1s/5min) */
+#define RATE_EXP_15 65463               /* 1/exp(1s/15min) */
 
+/*
+ * Kept small because the store can hold a million of these: 80 bytes on
+ * 64-bit. Records are found by seq through record_xa and by pid through
+ * pid_index, so the only list they sit on is their eviction LRU, whose
+ * space is reused for the RCU callback once the record is unlinked. The
+ * command name is an id into the interned comm table, swapped for the
+ * new name when the process execs. children/sibling link each record
+ * under the record of the process that forked it, so descendant queries
+ * only touch the subtree; nearly every record has a tracked parent, so
+ * moving the links out would cost a side entry per record. Fields only
+ * set by an exec, a thread or the exit live in struct record_extra.
+ */
 struct process_record {
+    union {
+        struct list_head lru;
+        struct rcu_head rcu;
+    };
+    struct rhash_head pid_node;
+    struct hlist_head children;     /* RCU, written under process_lock */
+    struct hlist_node sibling;
+    unsigned long seq;
+    u64 start_ns;
+    u32 lifetime_ms;            /* RECORD_RUNNING until the exit is seen */
     pid_t pid;
     pid_t ppid;
+    u16 exit_code;              /* wait status, fits in 16 bits */
+    u16 comm_id;
+};
+
+/*
+ * Side storage for a record that has exec'd, exited or, with
+ * thread_groups, created threads, keyed by its seq in record_extras. A
+ * record without one has no execs, a single thread and no exit usage.
+ */
+struct record_extra {
+    u32 execs;
+    u32 threads;                /* threads created, leader included */
+    u32 peak_threads;
+    u32 cpu_ms;                 /* utime + stime at exit */
+    u32 maxrss_kb;              /* peak RSS at exit */
+    struct rcu_head rcu;
+};
+
+/* One distinct command name, shared by every record that carries it */
+struct comm_entry {
     char comm[TASK_COMM_LEN];
-    unsigned long start_time;
-    unsigned long end_time;
-    int status;
-    unsigned long cpu_time;
-    unsigned long memory_usage;
-    int exit_code;
-    struct list_head list;
-    struct hlist_node hash;
-    struct rb_node rb_node;
+    u32 id;
+    unsigned int refs;          /* protected by process_lock */
+    struct hlist_node node;
+    struct rcu_head rcu;
+};
+
+/* Resource usage summed over exits */
+struct usage_totals {
+    u64 exits;
+    struct pm_usage sum;
+};
+
+/*
+ * Usage sums of one command name. Lives until reset_stats so the sums
+ * outlast the records; names past USAGE_COMMS_MAX go to usage_other.
+ */
+struct comm_usage {
+    char comm[TASK_COMM_LEN];
+    struct hlist_node node;
+    struct rcu_head rcu;
+    struct usage_totals totals;     /* written with process_lock held */
 };
 
 struct monitor_stats {
     unsigned long total_processes_created;
     unsigned long total_processes_exited;
+    unsigned long total_execs;
     unsigned long current_processes;
     unsigned long peak_processes;
-    unsigned long total_cpu_time;
-    unsigned long avg_lifetime;
-    unsigned long longest_lifetime;
-    unsigned long shortest_lifetime;
+    struct usage_totals usage;
+};
+
+/*
+ * Log-linear histogram of process lifetimes in nanoseconds. Values below
+ * LIFETIME_SUB_BUCKETS get a bucket each; above that every power of two
+ * is split into LIFETIME_SUB_BUCKETS equal steps.
+ */
+struct lifetime_hist {
+    u64 count;
+    u64 sum_ns;
+    u64 min_ns;
+    u64 max_ns;
+    u64 buckets[LIFETIME_BUCKETS];
+};
+
+/*
+ * Event counters bumped by the capture handlers on the local CPU and only
+ * summed when stats are read. live is this CPU's share of the running
+ * process count not yet folded into live_processes.
+ */
+struct cpu_stats {
+    unsigned long created;
+    unsigned long exited;
+    unsigned long execs;
+    long live;
+    unsigned long ingest_accepted;
+    unsigned long ingest_rejected;
+    unsigned long governor_skipped;
+    unsigned long threads_created;      /* thread_groups only */
+    unsigned long threads_exited;
+};
+
+/* Time the drain worker spends waiting for and holding process_lock */
+struct lock_timing {
+    u64 batches;
+    u64 max_wait_ns;
+    u64 total_wait_ns;
+    u64 max_hold_ns;
+    u64 total_hold_ns;
+};
+
+/*
+ * Space-saving sketch of the commands that fork most. Counters stay in
+ * place; heap orders their indices by count so the smallest is at the
+ * root, and buckets chain them by name hash. Bounded at TOPCOMM_SLOTS
+ * names whatever the workload.
+ */
+struct topcomm_counter {
+    char comm[TASK_COMM_LEN];
+    u64 count;
+    u64 error;                  /* count inherited from the evicted name */
+    u32 hash;
+    u8 heap_pos;
+    u8 next;                    /* next counter in the bucket chain */
+};
+
+struct topcomm_sketch {
+    u64 total;
+    unsigned int nr;
+    u8 heap[TOPCOMM_SLOTS];
+    u8 buckets[TOPCOMM_HASH_SIZE];
+    struct topcomm_counter counters[TOPCOMM_SLOTS];
+};
+
+struct rate_sample {
+    u32 created;
+    u32 exited;
+};
+
+/*
+ * Fork and exit counts of the last RATE_HISTORY_SECS seconds, plus
+ * exponentially decaying averages over 1, 5 and 15 minutes in the style
+ * of the load average. Written only by rate_timer.
+ */
+struct rate_history {
+    struct rate_sample samples[RATE_HISTORY_SECS];
+    unsigned long seconds;      /* samples taken, indexes samples modulo size */
+    u64 avg_created[3];         /* per second, RATE_FSHIFT fixed point */
+    u64 avg_exited[3];
+};
+
+/*
+ * Per-open state of the processes file. cursor is the seq of the next
+ * record to emit, so a read() resumes correctly even if records were
+ * evicted since the previous chunk.
+ */
+struct process_iter {
+    unsigned long cursor;
+    unsigned long matched;
+    int finished;
 };
 
 struct filter_config {
@@ -58,6 +271,154 @@ struct filter_config {
     int min_lifetime;
     int max_lifetime;
     int enabled;
+    uid_t target_uid;
+    int uid_set;
+    int exclude_kthreads;
+    int ingest;
+};
+
+enum ingest_flags {
+    INGEST_PID = 1 << 0,
+    INGEST_PPID = 1 << 1,
+    INGEST_COMM = 1 << 2,
+    INGEST_UID = 1 << 3,
+    INGEST_NO_KTHREAD = 1 << 4,
+    INGEST_RULES = 1 << 5,
+};
+
+/*
+ * Membership set for allow/deny rules: a bitmap indexed by pid and an
+ * open-addressed table of command names sized to at most half full, so
+ * a lookup costs the same with ten rules or ten thousand.
+ */
+struct rule_set {
+    unsigned long *pids;
+    unsigned int pid_bits;
+    unsigned int nr_pids;
+    char (*comms)[TASK_COMM_LEN];
+    unsigned int comm_slots;    /* power of two, or 0 */
+    unsigned int nr_comms;
+};
+
+/* Immutable once published; filter writes build a copy and swap it in */
+struct filter_rules {
+    struct rule_set allow;
+    struct rule_set deny;
+    struct rcu_head rcu;
+};
+
+/*
+ * Capture-time predicate compiled from filter_config whenever the filter
+ * file is written, so the handlers only test flags and compare words.
+ * Published under RCU and replaced as a whole.
+ */
+struct ingest_filter {
+    unsigned int flags;
+    pid_t pid;
+    pid_t ppid;
+    kuid_t uid;
+    unsigned int comm_len;
+    char comm[TASK_COMM_LEN];
+    struct rcu_head rcu;
+};
+
+enum governor_mode {
+    GOVERNOR_FULL,
+    GOVERNOR_SAMPLE,
+    GOVERNOR_COUNT_ONLY,
+};
+
+/* Values match enum pm_event_type so ring slots carry the type as-is */
+enum process_event_type {
+    PROCESS_EVENT_FORK = PM_EVENT_FORK,
+    PROCESS_EVENT_EXIT = PM_EVENT_EXIT,
+    PROCESS_EVENT_EXEC = PM_EVENT_EXEC,
+    PROCESS_EVENT_TYPES,
+};
+
+/* A thread joining an existing group; never leaves the drain worker */
+#define PROCESS_EVENT_THREAD PROCESS_EVENT_TYPES
+
+enum capture_mode {
+    CAPTURE_KPROBE,
+    CAPTURE_TRACEPOINT,
+};
+
+/* Fixed-size event captured by the probe handlers into a per-CPU buffer */
+struct process_event {
+    u64 timestamp;
+    unsigned long jiffies;
+    pid_t pid;
+    pid_t ppid;
+    int exit_code;
+    int type;
+    u32 weight;                 /* events this one stands for when sampled, 0 for a skipped exit */
+    u32 group_threads;          /* thread events: threads in the group */
+    char comm[TASK_COMM_LEN];
+    struct pm_usage usage;      /* exit events only */
+};
+
+/*
+ * Single-producer/single-consumer ring: head is advanced only by the
+ * handlers running on the owning CPU, tail only by the drain worker.
+ */
+struct staging_buffer {
+    unsigned int head;
+    unsigned int tail;
+    unsigned long dropped;
+    struct process_event *events;
+};
+
+/*
+ * Self-profiling slots: one per capture handler, indexed by event type,
+ * plus the drain worker's wait for and hold of process_lock.
+ */
+enum selfprof_slot {
+    SELFPROF_LOCK_WAIT = PROCESS_EVENT_TYPES,
+    SELFPROF_LOCK_HOLD,
+    SELFPROF_SLOTS,
+};
+
+/* Same bucket layout as lifetime_hist, cut off at SELFPROF_BUCKETS */
+struct selfprof_hist {
+    u64 count;
+    u64 sum_ns;
+    u64 max_ns;
+    u64 buckets[SELFPROF_BUCKETS];
+};
+
+struct selfprof_cpu {
+    struct selfprof_hist hists[SELFPROF_SLOTS];
+};
+
+struct capture_tracepoint {
+    const char *name;
+    void *probe;
+    struct tracepoint *tp;
+    int registered;
+};
+
+struct comm_count {
+    char comm[TASK_COMM_LEN];
+    unsigned long count;
+};
+
+/* Per-interval event counts, touched only by the drain worker */
+struct event_summary {
+    unsigned long start;
+    unsigned long forks;
+    unsigned long exits;
+    unsigned long execs;
+    unsigned long suppressed;
+    int nr_comms;
+    struct comm_count comms[SUMMARY_TOP_SLOTS];
+};
+
+struct drain_slot {
+    struct process_event event;
+    struct process_record *record;
+    unsigned long lifetime;
+    int report;
 };
 
 static struct proc_dir_entry *proc_dir;
@@ -65,60 +426,578 @@ static struct proc_dir_entry *proc_stats;
 static struct proc_dir_entry *proc_processes;
 static struct proc_dir_entry *proc_filter;
 static struct proc_dir_entry *proc_control;
+static struct proc_dir_entry *proc_backend;
+static struct proc_dir_entry *proc_tree;
+static struct proc_dir_entry *proc_topcomm;
+static struct proc_dir_entry *proc_rates;
+static struct proc_dir_entry *proc_snapshot;
+static struct proc_dir_entry *proc_selfprof;
 
 static struct monitor_stats stats;
+static DEFINE_PER_CPU(struct cpu_stats, cpu_stats);
+static struct monitor_stats stats_base;
+static struct lifetime_hist lifetime_hist; /* protected by process_lock and stats_seq */
+static atomic_long_t live_processes = ATOMIC_LONG_INIT(0);
+static atomic_long_t peak_processes = ATOMIC_LONG_INIT(0);
+static u64 monitor_start_ns;
 static struct filter_config filter = {0};
-static LIST_HEAD(process_list);
-static DEFINE_HASHTABLE(process_hash, PROCESS_HASH_BITS);
-static struct rb_root process_tree = RB_ROOT;
+static struct ingest_filter __rcu *ingest_filter;
+static struct filter_rules __rcu *filter_rules;
+static DEFINE_XARRAY(record_xa);        /* records by seq */
+static LIST_HEAD(running_lru);          /* by fork order */
+static LIST_HEAD(exited_lru);           /* by exit order */
+static struct rhashtable pid_index;
+static DEFINE_HASHTABLE(comm_hash, COMM_HASH_BITS);
+static DEFINE_XARRAY_ALLOC1(comm_ids);
+static DEFINE_XARRAY(record_extras);    /* struct record_extra by record seq */
+static unsigned int record_extra_count; /* protected by process_lock */
+static unsigned int comm_entries = 0;
+static DEFINE_HASHTABLE(usage_hash, USAGE_COMM_BITS);
+static unsigned int usage_comms = 0;
+static struct usage_totals usage_other;
 static DEFINE_SPINLOCK(process_lock);
+static seqcount_spinlock_t stats_seq = SEQCNT_SPINLOCK_ZERO(stats_seq, &process_lock);
+static struct lock_timing writer_timing;
+static struct topcomm_sketch topcomm;   /* protected by process_lock and stats_seq */
+static struct rate_history rate_history;
+static seqcount_t rate_seq = SEQCNT_ZERO(rate_seq);
+static struct hrtimer rate_timer;
+static unsigned long rate_prev_created, rate_prev_exited;
+static unsigned int rate_series_secs = 60;      /* seconds returned by the rates file */
 static DEFINE_MUTEX(config_mutex);
 static int record_count = 0;
+static unsigned int capacity = MAX_PROCESS_RECORDS;
+module_param(capacity, uint, 0444);
+MODULE_PARM_DESC(capacity, "Initial record store capacity, resizable via control (default 1000)");
+static unsigned int record_capacity;
+static unsigned long evicted_exited = 0;
+static unsigned long evicted_running = 0;
+static pid_t tree_root = 0;             /* subtree shown by the tree file */
+static unsigned long next_record_seq = 0;
+static u64 record_generation = 0;       /* bumped on every store change */
+static struct kmem_cache *record_cache;
+static struct kmem_cache *extra_cache;
+static mempool_t *record_pool;
+static unsigned long alloc_failures = 0;
 static int monitoring_enabled = 1;
 
 static struct kprobe kp_do_fork;
 static struct kprobe kp_do_exit;
+static struct kprobe kp_exec;
+static bool kp_exec_registered;
+
+static char *capture_backend = "kprobe";
+module_param(capture_backend, charp, 0444);
+MODULE_PARM_DESC(capture_backend, "Event source: kprobe or tracepoint (default kprobe)");
+static int capture_mode = CAPTURE_KPROBE;
+static bool thread_groups;
+module_param(thread_groups, bool, 0444);
+MODULE_PARM_DESC(thread_groups, "Record thread-group leaders only and count threads per process (default off)");
+static DEFINE_STATIC_KEY_FALSE(selfprof_key);
+
+static unsigned int governor_threshold = 20000;
+module_param(governor_threshold, uint, 0644);
+MODULE_PARM_DESC(governor_threshold, "Forks per second above which events are sampled (tracepoint backend only), 0 disables (default 20000)");
+static unsigned int governor_count_only = 200000;
+module_param(governor_count_only, uint, 0644);
+MODULE_PARM_DESC(governor_count_only, "Forks per second above which only counters are kept, 0 disables (default 200000)");
+static int governor_mode = GOVERNOR_FULL;
+static unsigned int governor_shift;     /* sampling keeps 1 in 1 << shift */
+static u64 governor_since;
+static unsigned long governor_switches;
+static struct selfprof_cpu __percpu *selfprof;  /* allocated on first enable */
+
+static bool verbose_events = false;
+module_param(verbose_events, bool, 0644);
+MODULE_PARM_DESC(verbose_events, "Log every fork/exit event, rate limited (default off)");
+static unsigned int summary_interval = 10;
+module_param(summary_interval, uint, 0644);
+MODULE_PARM_DESC(summary_interval, "Seconds between event summaries in the kernel log, 0 disables (default 10)");
+static DEFINE_RATELIMIT_STATE(event_ratelimit, 5 * HZ, 10);
+static struct event_summary summary;
+static unsigned long total_suppressed = 0;
+
+static unsigned int ring_events = 4096;
+module_param(ring_events, uint, 0444);
+MODULE_PARM_DESC(ring_events, "Slots in the " PM_DEVICE_PATH " event ring, rounded up to a power of two (default 4096)");
+/*
+ * The header page is mapped writable for the consumer's tail, so the
+ * kernel keeps its own copy of everything it indexes with and only
+ * mirrors it into the header.
+ */
+static struct pm_ring_header *event_ring;
+static struct pm_event *ring_slots;
+static unsigned long ring_size;
+static unsigned int ring_nr_events;
+static u64 ring_head;                   /* protected by ring_lock */
+static u64 ring_overruns;
+static atomic_t ring_users = ATOMIC_INIT(0);
+static int ring_active = 0;
+static DEFINE_SPINLOCK(ring_lock);
+static DECLARE_WAIT_QUEUE_HEAD(ring_wait);
+
+static unsigned int netlink_batch = 64;
+module_param(netlink_batch, uint, 0644);
+MODULE_PARM_DESC(netlink_batch, "Events per netlink message, 1-128 (default 64)");
+static unsigned int netlink_flush_ms = 200;
+module_param(netlink_flush_ms, uint, 0644);
+MODULE_PARM_DESC(netlink_flush_ms, "Longest a partial netlink batch is held, in ms (default 200)");
+/* Batch state, only touched by the drain worker */
+static struct pm_event netlink_pending[NETLINK_BATCH_MAX];
+static unsigned int netlink_nr_pending;
+static unsigned long netlink_batch_start;
+static u64 netlink_next_seq;
+static u64 netlink_messages;
+static u64 netlink_lost;
+
+static DEFINE_PER_CPU(struct staging_buffer, staging_buffers);
+static struct drain_slot *drain_slots;
+static unsigned int drain_quota;
+static struct drain_slot *deferred_exits;
+static unsigned int nr_deferred_exits;
+static void drain_staging_buffers(struct work_struct *work);
+static DECLARE_DELAYED_WORK(drain_work, drain_staging_buffers);
+
+/*
+ * Records stay indexed by pid until they are evicted or a newer record
+ * takes their pid, so exits and tree queries find theirs in O(1) whether
+ * it is still RUNNING or not. The table follows the size of the store.
+ */
+static const struct rhashtable_params pid_index_params = {
+    .key_len = sizeof(pid_t),
+    .key_offset = offsetof(struct process_record, pid),
+    .head_offset = offsetof(struct process_record, pid_node),
+    .automatic_shrinking = true,
+};
 
 static struct process_record *find_process_by_pid(pid_t pid)
 {
-    struct process_record *record;
+    return rhashtable_lookup_fast(&pid_index, &pid, pid_index_params);
+}
+
+/* Called with process_lock held */
+static struct process_record *find_running_by_pid(pid_t pid)
+{
+    struct process_record *record = find_process_by_pid(pid);
+    
+    return record && record->lifetime_ms == RECORD_RUNNING ? record : NULL;
+}
+
+/*
+ * Index a new RUNNING record. A still-indexed record with the same pid,
+ * exited or with its exit never seen, is displaced so lookups find the
+ * newest one.
+ */
+static void index_process_record(struct process_record *record)
+{
+    struct process_record *old;
+    
+    old = find_process_by_pid(record->pid);
+    if (old) {
+        if (rhashtable_replace_fast(&pid_index, &old->pid_node,
+                                    &record->pid_node, pid_index_params) == 0)
+            return;
+        rhashtable_remove_fast(&pid_index, &old->pid_node, pid_index_params);
+    }
+    
+    rhashtable_insert_fast(&pid_index, &record->pid_node, pid_index_params);
+}
+
+/* A no-op for a record already displaced by a newer one */
+static void unindex_process_record(struct process_record *record)
+{
+    rhashtable_remove_fast(&pid_index, &record->pid_node, pid_index_params);
+}
+
+/*
+ * Return the id of the interned copy of comm, taking a reference. 0 means
+ * the table could not grow and the record will show as "?". Called with
+ * process_lock held.
+ */
+static u16 intern_comm(const char *comm)
+{
+    struct comm_entry *entry;
+    u32 hash = full_name_hash(NULL, comm, strnlen(comm, TASK_COMM_LEN));
     
-    hash_for_each_possible(process_hash, record, hash, pid) {
-        if (record->pid == pid && record->status == 1) {
-            return record;
+    hash_for_each_possible(comm_hash, entry, node, hash) {
+        if (strncmp(entry->comm, comm, TASK_COMM_LEN) == 0) {
+            entry->refs++;
+            return entry->id;
         }
     }
     
+    entry = kmalloc(sizeof(*entry), GFP_NOWAIT | __GFP_NOWARN);
+    if (!entry)
+        return 0;
+    
+    memcpy(entry->comm, comm, TASK_COMM_LEN);
+    entry->refs = 1;
+    if (xa_alloc(&comm_ids, &entry->id, entry, XA_LIMIT(1, COMM_ID_MAX),
+                 GFP_NOWAIT | __GFP_NOWARN) < 0) {
+        kfree(entry);
+        return 0;
+    }
+    
+    hash_add(comm_hash, &entry->node, hash);
+    comm_entries++;
+    return entry->id;
+}
+
+/* Called with process_lock held */
+static void put_comm(u16 id)
+{
+    struct comm_entry *entry = id ? xa_load(&comm_ids, id) : NULL;
+    
+    if (!entry || --entry->refs)
+        return;
+    
+    hash_del(&entry->node);
+    xa_erase(&comm_ids, id);
+    comm_entries--;
+    kfree_rcu(entry, rcu);
+}
+
+/* Called under RCU or with process_lock held */
+static const char *comm_name(u16 id)
+{
+    struct comm_entry *entry = id ? xa_load(&comm_ids, id) : NULL;
+    
+    return entry ? entry->comm : "?";
+}
+
+static const char *record_comm(const struct process_record *record)
+{
+    return comm_name(READ_ONCE(record->comm_id));
+}
+
+static void free_comm_table(void)
+{
+    struct comm_entry *entry;
+    unsigned long id;
+    
+    xa_for_each(&comm_ids, id, entry)
+        kfree(entry);
+    xa_destroy(&comm_ids);
+}
+
+/* Called with process_lock held. NULL if the entry could not be added */
+static struct record_extra *get_record_extra(struct process_record *record)
+{
+    struct record_extra *extra = xa_load(&record_extras, record->seq);
+    
+    if (extra)
+        return extra;
+    
+    extra = kmem_cache_zalloc(extra_cache, GFP_NOWAIT | __GFP_NOWARN);
+    if (!extra)
+        goto fail;
+    extra->threads = 1;
+    extra->peak_threads = 1;
+    if (xa_is_err(xa_store(&record_extras, record->seq, extra, GFP_NOWAIT | __GFP_NOWARN))) {
+        kmem_cache_free(extra_cache, extra);
+        goto fail;
+    }
+    
+    WRITE_ONCE(record_extra_count, record_extra_count + 1);
+    return extra;
+    
+fail:
+    alloc_failures++;
     return NULL;
 }
 
-static void insert_process_rb_tree(struct process_record *record)
+/* Called under RCU or with process_lock held */
+static void read_record_extra(const struct process_record *record, struct record_extra *out)
 {
-    struct rb_node **new = &(process_tree.rb_node);
-    struct rb_node *parent = NULL;
-    struct process_record *this;
+    const struct record_extra *extra = xa_load(&record_extras, record->seq);
     
-    while (*new) {
-        this = container_of(*new, struct process_record, rb_node);
-        parent = *new;
-        
-        if (record->start_time < this->start_time)
-            new = &((*new)->rb_left);
-        else
-            new = &((*new)->rb_right);
+    out->execs = extra ? READ_ONCE(extra->execs) : 0;
+    out->threads = extra ? READ_ONCE(extra->threads) : 1;
+    out->peak_threads = extra ? READ_ONCE(extra->peak_threads) : 1;
+    out->cpu_ms = extra ? READ_ONCE(extra->cpu_ms) : 0;
+    out->maxrss_kb = extra ? READ_ONCE(extra->maxrss_kb) : 0;
+}
+
+static void free_record_extra_rcu(struct rcu_head *head)
+{
+    kmem_cache_free(extra_cache, container_of(head, struct record_extra, rcu));
+}
+
+static void free_record_extras(void)
+{
+    struct record_extra *extra;
+    unsigned long seq;
+    
+    xa_for_each(&record_extras, seq, extra)
+        kmem_cache_free(extra_cache, extra);
+    xa_destroy(&record_extras);
+}
+
+static void free_process_record_rcu(struct rcu_head *head)
+{
+    mempool_free(container_of(head, struct process_record, rcu), record_pool);
+}
+
+/*
+ * Unlink a record from every structure. Its children are orphaned and
+ * become subtree roots of their own. Called with process_lock held; the
+ * memory goes back to the pool once current /proc readers are done.
+ */
+static void release_process_record(struct process_record *record)
+{
+    struct process_record *child;
+    struct record_extra *extra;
+    struct hlist_node *tmp;
+    
+    hlist_for_each_entry_safe(child, tmp, &record->children, sibling)
+        hlist_del_init_rcu(&child->sibling);
+    hlist_del_init_rcu(&record->sibling);
+    
+    xa_erase(&record_xa, record->seq);
+    extra = xa_erase(&record_extras, record->seq);
+    if (extra) {
+        call_rcu(&extra->rcu, free_record_extra_rcu);
+        WRITE_ONCE(record_extra_count, record_extra_count - 1);
+    }
+    list_del(&record->lru);
+    unindex_process_record(record);
+    put_comm(record->comm_id);
+    call_rcu(&record->rcu, free_process_record_rcu);
+    record_count--;
+    WRITE_ONCE(record_generation, record_generation + 1);
+}
+
+static int rule_set_has_pid(const struct rule_set *set, pid_t pid)
+{
+    return pid >= 0 && pid < set->pid_bits && test_bit(pid, set->pids);
+}
+
+static int rule_set_has_comm(const struct rule_set *set, const char *comm)
+{
+    unsigned int mask = set->comm_slots - 1;
+    unsigned int i;
+    
+    if (!set->nr_comms)
+        return 0;
+    
+    i = full_name_hash(NULL, comm, strnlen(comm, TASK_COMM_LEN)) & mask;
+    while (set->comms[i][0]) {
+        if (strncmp(set->comms[i], comm, TASK_COMM_LEN) == 0)
+            return 1;
+        i = (i + 1) & mask;
+    }
+    
+    return 0;
+}
+
+static int rules_match(const struct filter_rules *rules, pid_t pid, const char *comm)
+{
+    if (rule_set_has_pid(&rules->deny, pid) || rule_set_has_comm(&rules->deny, comm))
+        return 0;
+    
+    if (!rules->allow.nr_pids && !rules->allow.nr_comms)
+        return 1;
+    
+    return rule_set_has_pid(&rules->allow, pid) || rule_set_has_comm(&rules->allow, comm);
+}
+
+static void rule_set_free(struct rule_set *set)
+{
+    kvfree(set->pids);
+    kvfree(set->comms);
+    memset(set, 0, sizeof(*set));
+}
+
+static void free_filter_rules(struct filter_rules *rules)
+{
+    if (!rules)
+        return;
+    rule_set_free(&rules->allow);
+    rule_set_free(&rules->deny);
+    kfree(rules);
+}
+
+static void free_filter_rules_rcu(struct rcu_head *head)
+{
+    free_filter_rules(container_of(head, struct filter_rules, rcu));
+}
+
+static int rule_set_resize_pids(struct rule_set *set, unsigned int bits)
+{
+    unsigned long *pids = kvcalloc(BITS_TO_LONGS(bits), sizeof(long), GFP_KERNEL);
+    
+    if (!pids)
+        return -ENOMEM;
+    if (set->pids)
+        memcpy(pids, set->pids, BITS_TO_LONGS(set->pid_bits) * sizeof(long));
+    kvfree(set->pids);
+    set->pids = pids;
+    set->pid_bits = bits;
+    return 0;
+}
+
+static int rule_set_add_pids(struct rule_set *set, pid_t first, pid_t last)
+{
+    pid_t pid;
+    
+    if (first < 0 || last < first || last >= PID_MAX_LIMIT)
+        return -EINVAL;
+    
+    if (last >= set->pid_bits &&
+        rule_set_resize_pids(set, max_t(unsigned int, roundup_pow_of_two(last + 1),
+                                        RULE_PID_MIN_BITS)) < 0)
+        return -ENOMEM;
+    
+    for (pid = first; pid <= last; pid++) {
+        if (!test_bit(pid, set->pids)) {
+            __set_bit(pid, set->pids);
+            set->nr_pids++;
+        }
+    }
+    
+    return 0;
+}
+
+static void rule_set_insert_comm(struct rule_set *set, const char *comm)
+{
+    unsigned int mask = set->comm_slots - 1;
+    unsigned int i = full_name_hash(NULL, comm, strnlen(comm, TASK_COMM_LEN)) & mask;
+    
+    while (set->comms[i][0])
+        i = (i + 1) & mask;
+    strscpy_pad(set->comms[i], comm, TASK_COMM_LEN);
+    set->nr_comms++;
+}
+
+static int rule_set_resize_comms(struct rule_set *set, unsigned int slots)
+{
+    struct rule_set grown = *set;
+    unsigned int i;
+    
+    grown.comms = kvcalloc(slots, TASK_COMM_LEN, GFP_KERNEL);
+    if (!grown.comms)
+        return -ENOMEM;
+    grown.comm_slots = slots;
+    grown.nr_comms = 0;
+    
+    for (i = 0; i < set->comm_slots; i++) {
+        if (set->comms[i][0])
+            rule_set_insert_comm(&grown, set->comms[i]);
+    }
+    
+    kvfree(set->comms);
+    *set = grown;
+    return 0;
+}
+
+static int rule_set_add_comm(struct rule_set *set, const char *comm)
+{
+    if (!comm[0] || rule_set_has_comm(set, comm))
+        return 0;
+    
+    if ((set->nr_comms + 1) * 2 > set->comm_slots &&
+        rule_set_resize_comms(set, max_t(unsigned int, set->comm_slots * 2,
+                                         RULE_COMM_MIN_SLOTS)) < 0)
+        return -ENOMEM;
+    
+    rule_set_insert_comm(set, comm);
+    return 0;
+}
+
+static int rule_set_copy(struct rule_set *dst, const struct rule_set *src)
+{
+    memset(dst, 0, sizeof(*dst));
+    
+    if (src->pid_bits) {
+        dst->pids = kvmalloc_array(BITS_TO_LONGS(src->pid_bits), sizeof(long), GFP_KERNEL);
+        if (!dst->pids)
+            return -ENOMEM;
+        memcpy(dst->pids, src->pids, BITS_TO_LONGS(src->pid_bits) * sizeof(long));
+        dst->pid_bits = src->pid_bits;
+        dst->nr_pids = src->nr_pids;
+    }
+    
+    if (src->comm_slots) {
+        dst->comms = kvmalloc_array(src->comm_slots, TASK_COMM_LEN, GFP_KERNEL);
+        if (!dst->comms) {
+            rule_set_free(dst);
+            return -ENOMEM;
+        }
+        memcpy(dst->comms, src->comms, (size_t)src->comm_slots * TASK_COMM_LEN);
+        dst->comm_slots = src->comm_slots;
+        dst->nr_comms = src->nr_comms;
+    }
+    
+    return 0;
+}
+
+/* Private copy of the published rules for a filter write to modify */
+static struct filter_rules *clone_filter_rules(void)
+{
+    struct filter_rules *old = rcu_dereference_protected(filter_rules,
+                                                         lockdep_is_held(&config_mutex));
+    struct filter_rules *rules = kzalloc(sizeof(*rules), GFP_KERNEL);
+    
+    if (!rules)
+        return NULL;
+    
+    if (old && (rule_set_copy(&rules->allow, &old->allow) < 0 ||
+                rule_set_copy(&rules->deny, &old->deny) < 0)) {
+        free_filter_rules(rules);
+        return NULL;
     }
     
-    rb_link_node(&record->rb_node, parent, new);
-    rb_insert_color(&record->rb_node, &process_tree);
+    return rules;
 }
 
-static void remove_process_rb_tree(struct process_record *record)
+static int filter_has_rules(const struct filter_rules *rules)
 {
-    rb_erase(&record->rb_node, &process_tree);
+    return rules && (rules->allow.nr_pids || rules->allow.nr_comms ||
+                     rules->deny.nr_pids || rules->deny.nr_comms);
+}
+
+/*
+ * Parse "allow|deny pid|comm <list>" where list is comma separated and
+ * pids may be given as ranges a-b.
+ */
+static int parse_rule_list(struct rule_set *set, const char *kind, char *list)
+{
+    char *item, *dash;
+    int first, last;
+    int ret;
+    
+    while ((item = strsep(&list, ",")) != NULL) {
+        item = strim(item);
+        if (!*item)
+            continue;
+        
+        if (strcmp(kind, "comm") == 0) {
+            ret = rule_set_add_comm(set, item);
+        } else if (strcmp(kind, "pid") == 0) {
+            dash = strchr(item, '-');
+            if (dash)
+                *dash++ = '\0';
+            if (kstrtoint(item, 10, &first) ||
+                (dash ? kstrtoint(dash, 10, &last) : (last = first, 0)))
+                return -EINVAL;
+            ret = rule_set_add_pids(set, first, last);
+        } else {
+            return -EINVAL;
+        }
+        
+        if (ret < 0)
+            return ret;
+    }
+    
+    return 0;
 }
 
 static int process_matches_filter(struct process_record *record)
 {
+    const struct filter_rules *rules;
+    u32 lifetime_ms;
+    int match = 1;
+    
     if (!filter.enabled)
         return 1;
     
@@ -129,253 +1008,2772 @@ static int process_matches_filter(struct process_record *record)
         return 0;
     
     if (strlen(filter.target_comm) && 
-        strncmp(record->comm, filter.target_comm, TASK_COMM_LEN) != 0)
+        strncmp(record_comm(record), filter.target_comm, TASK_COMM_LEN) != 0)
         return 0;
     
-    if (record->status == 0) {
-        unsigned long lifetime = (record->end_time - record->start_time) / HZ;
+    lifetime_ms = smp_load_acquire(&record->lifetime_ms);
+    if (lifetime_ms != RECORD_RUNNING) {
+        unsigned long lifetime = lifetime_ms / MSEC_PER_SEC;
         if (filter.min_lifetime && lifetime < filter.min_lifetime)
             return 0;
         if (filter.max_lifetime && lifetime > filter.max_lifetime)
             return 0;
     }
     
-    return 1;
+    rcu_read_lock();
+    rules = rcu_dereference(filter_rules);
+    if (rules)
+        match = rules_match(rules, record->pid, record_comm(record));
+    rcu_read_unlock();
+    
+    return match;
 }
 
-static void add_process_record(pid_t pid, pid_t ppid, const char *comm)
+/*
+ * Snapshot what the exiting task used, from counters the kernel already
+ * keeps: a few loads, no locks. The kprobe backend runs before exit_mm()
+ * and sees the mm; by the tracepoint do_exit() has folded the mm's peak
+ * into signal->maxrss.
+ */
+static void fill_exit_usage(struct pm_usage *usage, struct task_struct *task)
 {
-    struct process_record *record;
-    unsigned long flags;
-    
-    if (!monitoring_enabled)
-        return;
+    unsigned long maxrss = READ_ONCE(task->signal->maxrss);
+    u64 utime, stime;
     
-    record = kmalloc(sizeof(struct process_record), GFP_ATOMIC);
-    if (!record) {
-        printk(KERN_WARNING "process_monitor: Failed to allocate memory for process record\n");
-        return;
-    }
+    task_cputime(task, &utime, &stime);
+    if (task->mm)
+        maxrss = max(maxrss, get_mm_hiwater_rss(task->mm));
     
-    record->pid = pid;
-    record->ppid = ppid;
-    strncpy(record->comm, comm, TASK_COMM_LEN);
-    record->comm[TASK_COMM_LEN-1] = '\0';
-    record->start_time = jiffies;
-    record->end_time = 0;
-    record->status = 1;
-    record->cpu_time = 0;
-    record->memory_usage = 0;
-    record->exit_code = 0;
+    usage->utime_ns = utime;
+    usage->stime_ns = stime;
+    usage->maxrss_kb = (u64)maxrss << (PAGE_SHIFT - 10);
+    usage->nvcsw = task->nvcsw;
+    usage->nivcsw = task->nivcsw;
+    usage->min_flt = task->min_flt;
+    usage->maj_flt = task->maj_flt;
+#ifdef CONFIG_TASK_IO_ACCOUNTING
+    usage->read_bytes = task->ioac.read_bytes;
+    usage->write_bytes = task->ioac.write_bytes;
+#else
+    usage->read_bytes = 0;
+    usage->write_bytes = 0;
+#endif
+}
+
+static void fill_process_event(struct process_event *event, int type,
+                               struct task_struct *task, pid_t ppid)
+{
+    event->timestamp = ktime_get_ns();
+    event->jiffies = jiffies;
+    event->type = type;
+    event->pid = thread_groups ? task->tgid : task->pid;
+    event->ppid = ppid;
+    event->exit_code = task->exit_code;
+    event->weight = 1;
+    memcpy(event->comm, task->comm, TASK_COMM_LEN);
+    event->comm[TASK_COMM_LEN-1] = '\0';
     
-    spin_lock_irqsave(&process_lock, flags);
+    if (type == PROCESS_EVENT_EXIT)
+        fill_exit_usage(&event->usage, task);
+    else
+        memset(&event->usage, 0, sizeof(event->usage));
     
-    if (record_count >= MAX_PROCESS_RECORDS) {
-        struct process_record *oldest;
-        oldest = list_first_entry(&process_list, struct process_record, list);
-        list_del(&oldest->list);
-        hash_del(&oldest->hash);
-        remove_process_rb_tree(oldest);
-        kfree(oldest);
-        record_count--;
-    }
+    /* The kprobe runs in the caller, before the new thread is counted */
+    event->group_threads = type == PROCESS_EVENT_THREAD ?
+                           get_nr_threads(task) + (task == current) : 0;
+}
+
+static void raise_peak_processes(long live)
+{
+    long peak = atomic_long_read(&peak_processes);
+    
+    while (live > peak) {
+        if (atomic_long_try_cmpxchg(&peak_processes, &peak, live))
+            break;
+    }
+}
+
+/*
+ * Move this CPU's live count into the global total once it has drifted
+ * by LIVE_FOLD_BATCH, so the peak only needs a global compare every
+ * batch forks and lags the true peak by at most nr_cpu_ids * batch.
+ */
+static void account_live_process(long delta)
+{
+    struct cpu_stats *cs = this_cpu_ptr(&cpu_stats);
+    long live = cs->live + delta;
+    
+    if (live >= LIVE_FOLD_BATCH || live <= -LIVE_FOLD_BATCH) {
+        cs->live = 0;
+        live = atomic_long_add_return(live, &live_processes);
+        if (delta > 0)
+            raise_peak_processes(live);
+        return;
+    }
+    
+    cs->live = live;
+}
+
+/* Called from the capture handlers with preemption disabled */
+static void count_process_event(int type, struct task_struct *task)
+{
+    struct cpu_stats *cs = this_cpu_ptr(&cpu_stats);
+    
+    if (type == PROCESS_EVENT_FORK) {
+        cs->created++;
+        account_live_process(1);
+    } else if (type == PROCESS_EVENT_EXEC) {
+        cs->execs++;
+    } else if (type == PROCESS_EVENT_THREAD) {
+        cs->threads_created++;
+    } else {
+        cs->exited++;
+        /* Tasks that predate the module never counted as live */
+        if (task->start_time >= monitor_start_ns)
+            account_live_process(-1);
+    }
+}
+
+static int ingest_matches(const struct ingest_filter *f, struct task_struct *task, pid_t ppid)
+{
+    if ((f->flags & INGEST_NO_KTHREAD) && (task->flags & PF_KTHREAD))
+        return 0;
+    if ((f->flags & INGEST_PID) && task->pid != f->pid)
+        return 0;
+    if ((f->flags & INGEST_PPID) && ppid != f->ppid)
+        return 0;
+    if ((f->flags & INGEST_COMM) && memcmp(task->comm, f->comm, f->comm_len + 1) != 0)
+        return 0;
+    if ((f->flags & INGEST_UID) && !uid_eq(task_uid(task), f->uid))
+        return 0;
+    if (f->flags & INGEST_RULES) {
+        const struct filter_rules *rules = rcu_dereference(filter_rules);
+        
+        if (rules && !rules_match(rules, task->pid, task->comm))
+            return 0;
+    }
+    
+    return 1;
+}
+
+/*
+ * Decide in the handler whether a fork or exec is worth staging at all.
+ * Exits always pass: they allocate nothing, and dropping one whose fork
+ * was kept would leave its record RUNNING once comm or ppid changed.
+ * Thread events pass for the same reason; they only count against a
+ * record the filter already let in.
+ */
+static int ingest_accepts(int type, struct task_struct *task, pid_t ppid)
+{
+    const struct ingest_filter *f;
+    int accept = 1;
+    
+    if (type == PROCESS_EVENT_EXIT || type == PROCESS_EVENT_THREAD)
+        return 1;
+    
+    rcu_read_lock();
+    f = rcu_dereference(ingest_filter);
+    if (f) {
+        accept = ingest_matches(f, task, ppid);
+        if (accept)
+            this_cpu_inc(cpu_stats.ingest_accepted);
+        else
+            this_cpu_inc(cpu_stats.ingest_rejected);
+    }
+    rcu_read_unlock();
+    
+    return accept;
+}
+
+static void thread_counts(unsigned long *created, unsigned long *exited)
+{
+    int cpu;
+    
+    *created = 0;
+    *exited = 0;
+    for_each_possible_cpu(cpu) {
+        *created += READ_ONCE(per_cpu_ptr(&cpu_stats, cpu)->threads_created);
+        *exited += READ_ONCE(per_cpu_ptr(&cpu_stats, cpu)->threads_exited);
+    }
+}
+
+static void ingest_counts(unsigned long *accepted, unsigned long *rejected)
+{
+    int cpu;
+    
+    *accepted = 0;
+    *rejected = 0;
+    for_each_possible_cpu(cpu) {
+        *accepted += READ_ONCE(per_cpu_ptr(&cpu_stats, cpu)->ingest_accepted);
+        *rejected += READ_ONCE(per_cpu_ptr(&cpu_stats, cpu)->ingest_rejected);
+    }
+}
+
+/* Called with config_mutex held */
+static void publish_ingest_filter(void)
+{
+    struct ingest_filter *f = NULL, *old;
+    
+    if (filter.ingest) {
+        f = kzalloc(sizeof(*f), GFP_KERNEL);
+        if (!f) {
+            printk(KERN_WARNING "process_monitor: Ingest filter not updated, out of memory\n");
+            return;
+        }
+        
+        if (filter.target_pid) {
+            f->flags |= INGEST_PID;
+            f->pid = filter.target_pid;
+        }
+        if (filter.target_ppid) {
+            f->flags |= INGEST_PPID;
+            f->ppid = filter.target_ppid;
+        }
+        if (strlen(filter.target_comm)) {
+            f->flags |= INGEST_COMM;
+            f->comm_len = strlen(filter.target_comm);
+            memcpy(f->comm, filter.target_comm, TASK_COMM_LEN);
+        }
+        if (filter.uid_set) {
+            f->flags |= INGEST_UID;
+            f->uid = make_kuid(current_user_ns(), filter.target_uid);
+        }
+        if (filter.exclude_kthreads)
+            f->flags |= INGEST_NO_KTHREAD;
+        if (filter_has_rules(rcu_dereference_protected(filter_rules,
+                                                       lockdep_is_held(&config_mutex))))
+            f->flags |= INGEST_RULES;
+    }
+    
+    old = rcu_replace_pointer(ingest_filter, f, lockdep_is_held(&config_mutex));
+    if (old)
+        kfree_rcu(old, rcu);
+}
+
+/*
+ * Weight of an event under the governor, 0 if it is skipped. Sampling
+ * is by thread-group id hash so a process's fork, exit and threads are
+ * kept or skipped together. That needs the fork event to describe the
+ * child, so update_governor only samples on the tracepoint backend.
+ * Exits are staged even at weight 0, see __stage_process_event.
+ */
+static u32 governor_weight(struct task_struct *task)
+{
+    int mode = READ_ONCE(governor_mode);
+    unsigned int shift;
+    
+    if (likely(mode == GOVERNOR_FULL))
+        return 1;
+    if (mode == GOVERNOR_COUNT_ONLY)
+        return 0;
+    
+    shift = READ_ONCE(governor_shift);
+    if (hash_32(task->tgid, GOVERNOR_MAX_SHIFT) & ((1U << shift) - 1))
+        return 0;
+    return 1U << shift;
+}
+
+static void __stage_process_event(int type, struct task_struct *task, pid_t ppid)
+{
+    struct staging_buffer *buf = this_cpu_ptr(&staging_buffers);
+    unsigned int head = buf->head;
+    unsigned int tail = smp_load_acquire(&buf->tail);
+    struct process_event *event;
+    u32 weight;
+    
+    /* Its group's record never sees it: no staging, no lookup */
+    if (thread_groups && type == PROCESS_EVENT_EXIT && !thread_group_leader(task)) {
+        this_cpu_inc(cpu_stats.threads_exited);
+        return;
+    }
+    
+    count_process_event(type, task);
+    
+    /*
+     * A skipped exit still has to close a record forked before the
+     * governor left FULL, or that record stays RUNNING and is evicted
+     * last. It goes through at weight 0: it closes its record but stands
+     * for no exits in the scaled totals.
+     */
+    weight = governor_weight(task);
+    if (!weight && type != PROCESS_EVENT_EXIT) {
+        this_cpu_inc(cpu_stats.governor_skipped);
+        return;
+    }
+    
+    if (!ingest_accepts(type, task, ppid))
+        return;
+    
+    if (head - tail >= STAGING_BUFFER_SIZE) {
+        buf->dropped++;
+        return;
+    }
+    
+    event = &buf->events[head & (STAGING_BUFFER_SIZE - 1)];
+    fill_process_event(event, type, task, ppid);
+    event->weight = weight;
+    
+    smp_store_release(&buf->head, head + 1);
+    
+    if (head - tail + 1 == STAGING_KICK_THRESHOLD)
+        mod_delayed_work(system_wq, &drain_work, 0);
+}
+
+/*
+ * Sum the per-CPU event counters into snap. Counts are relative to the
+ * last reset_stats, recorded in stats_base.
+ */
+static void fold_cpu_stats(struct monitor_stats *snap, const struct monitor_stats *base)
+{
+    unsigned long created = 0, exited = 0, execs = 0;
+    long live = atomic_long_read(&live_processes);
+    int cpu;
+    
+    for_each_possible_cpu(cpu) {
+        struct cpu_stats *cs = per_cpu_ptr(&cpu_stats, cpu);
+        
+        created += READ_ONCE(cs->created);
+        exited += READ_ONCE(cs->exited);
+        execs += READ_ONCE(cs->execs);
+        live += READ_ONCE(cs->live);
+    }
+    
+    if (live < 0)
+        live = 0;
+    raise_peak_processes(live);
+    
+    snap->total_processes_created = created - base->total_processes_created;
+    snap->total_processes_exited = exited - base->total_processes_exited;
+    snap->total_execs = execs - base->total_execs;
+    snap->current_processes = live;
+    snap->peak_processes = atomic_long_read(&peak_processes);
+}
+
+static u64 rate_decay(u64 avg, u64 exp, u32 n)
+{
+    return (avg * exp + ((u64)n << RATE_FSHIFT) * (RATE_FIXED_1 - exp)) >> RATE_FSHIFT;
+}
+
+static void push_rate_sample(u32 created, u32 exited)
+{
+    static const u64 exps[3] = { RATE_EXP_1, RATE_EXP_5, RATE_EXP_15 };
+    struct rate_history *h = &rate_history;
+    struct rate_sample *sample = &h->samples[h->seconds % RATE_HISTORY_SECS];
+    int i;
+    
+    sample->created = created;
+    sample->exited = exited;
+    h->seconds++;
+    for (i = 0; i < 3; i++) {
+        h->avg_created[i] = rate_decay(h->avg_created[i], exps[i], created);
+        h->avg_exited[i] = rate_decay(h->avg_exited[i], exps[i], exited);
+    }
+}
+
+static const char *governor_mode_name(int mode)
+{
+    static const char * const names[] = { "FULL", "SAMPLING", "COUNT ONLY" };
+    
+    return names[mode];
+}
+
+/*
+ * Pick the capture mode for the next second from the fork rate of the
+ * last one. The rate comes from the per-CPU counters, which see every
+ * event in every mode. Stepping down waits until the rate is a quarter
+ * below the threshold that was crossed, so a rate hovering at the
+ * threshold does not flap. The kprobe backend cannot sample: its fork
+ * probe runs in the parent, so a fork and the child's exit would be
+ * keyed differently. It stays FULL up to the count-only threshold.
+ * Called from rate_tick.
+ */
+static void update_governor(u32 forks)
+{
+    unsigned int threshold = READ_ONCE(governor_threshold);
+    unsigned int count_only = READ_ONCE(governor_count_only);
+    unsigned int shift = 0, limit;
+    int mode = GOVERNOR_FULL;
+    
+    if (count_only && forks > count_only) {
+        mode = GOVERNOR_COUNT_ONLY;
+    } else if (threshold && forks > threshold && capture_mode != CAPTURE_KPROBE) {
+        mode = GOVERNOR_SAMPLE;
+        shift = min_t(unsigned int, order_base_2(DIV_ROUND_UP(forks, threshold)),
+                      GOVERNOR_MAX_SHIFT);
+    }
+    
+    if (mode < governor_mode) {
+        limit = governor_mode == GOVERNOR_COUNT_ONLY ? count_only : threshold;
+        if (limit && forks > limit - limit / 4)
+            return;
+    }
+    
+    WRITE_ONCE(governor_shift, shift);
+    if (mode != governor_mode) {
+        WRITE_ONCE(governor_since, ktime_get_ns());
+        WRITE_ONCE(governor_switches, governor_switches + 1);
+        WRITE_ONCE(governor_mode, mode);
+        printk(KERN_INFO "process_monitor: Capture governor: %s at %u forks/sec\n",
+               governor_mode_name(mode), forks);
+    }
+}
+
+/*
+ * Once a second, fold the per-CPU event counters into one sample. The
+ * counters are free running, so the handlers pay nothing extra and a
+ * late tick only moves counts into the next sample. Seconds the timer
+ * missed entirely are recorded as empty.
+ */
+static enum hrtimer_restart rate_tick(struct hrtimer *timer)
+{
+    unsigned long created = 0, exited = 0;
+    u64 missed;
+    int cpu;
+    
+    missed = hrtimer_forward_now(timer, ns_to_ktime(NSEC_PER_SEC));
+    
+    for_each_possible_cpu(cpu) {
+        struct cpu_stats *cs = per_cpu_ptr(&cpu_stats, cpu);
+        
+        created += READ_ONCE(cs->created);
+        exited += READ_ONCE(cs->exited);
+    }
+    
+    write_seqcount_begin(&rate_seq);
+    while (missed-- > 1)
+        push_rate_sample(0, 0);
+    push_rate_sample(created - rate_prev_created, exited - rate_prev_exited);
+    write_seqcount_end(&rate_seq);
+    
+    update_governor(created - rate_prev_created);
+    
+    rate_prev_created = created;
+    rate_prev_exited = exited;
+    return HRTIMER_RESTART;
+}
+
+static void start_rate_timer(void)
+{
+    int cpu;
+    
+    for_each_possible_cpu(cpu) {
+        rate_prev_created += per_cpu_ptr(&cpu_stats, cpu)->created;
+        rate_prev_exited += per_cpu_ptr(&cpu_stats, cpu)->exited;
+    }
+    
+    governor_since = ktime_get_ns();
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+    hrtimer_setup(&rate_timer, rate_tick, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+#else
+    hrtimer_init(&rate_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+    rate_timer.function = rate_tick;
+#endif
+    hrtimer_start(&rate_timer, ns_to_ktime(NSEC_PER_SEC), HRTIMER_MODE_REL_SOFT);
+}
+
+static struct rate_history *snapshot_rates(void)
+{
+    struct rate_history *h;
+    unsigned int seq;
+    
+    h = kmalloc(sizeof(*h), GFP_KERNEL);
+    if (!h)
+        return NULL;
+    
+    do {
+        seq = read_seqcount_begin(&rate_seq);
+        *h = rate_history;
+    } while (read_seqcount_retry(&rate_seq, seq));
+    
+    return h;
+}
+
+/* Mean per-second rate over the last secs samples, in hundredths */
+static u64 rate_mean_x100(const struct rate_history *h, unsigned int secs, int exited)
+{
+    unsigned long i, n = min_t(unsigned long, secs, h->seconds);
+    u64 sum = 0;
+    
+    for (i = 1; i <= n; i++) {
+        const struct rate_sample *sample = &h->samples[(h->seconds - i) % RATE_HISTORY_SECS];
+        sum += exited ? sample->exited : sample->created;
+    }
+    
+    return n ? div_u64(sum * 100, n) : 0;
+}
+
+static unsigned long staging_dropped_events(void)
+{
+    unsigned long dropped = 0;
+    int cpu;
+    
+    for_each_possible_cpu(cpu)
+        dropped += per_cpu_ptr(&staging_buffers, cpu)->dropped;
+    
+    return dropped;
+}
+
+static struct process_record *alloc_process_record(const struct process_event *event)
+{
+    struct process_record *record;
+    
+    record = mempool_alloc(record_pool, GFP_NOWAIT | __GFP_NOWARN);
+    if (!record) {
+        alloc_failures++;
+        return NULL;
+    }
+    
+    record->pid = event->pid;
+    record->ppid = event->ppid;
+    record->start_ns = event->timestamp;
+    record->lifetime_ms = RECORD_RUNNING;
+    record->exit_code = 0;
+    record->comm_id = 0;
+    INIT_HLIST_HEAD(&record->children);
+    INIT_HLIST_NODE(&record->sibling);
+    
+    return record;
+}
+
+/*
+ * Make room for one record. The longest-exited record goes first; a
+ * RUNNING record is only dropped when none have exited, since its exit
+ * would then go unmatched. Called with process_lock held.
+ */
+static void evict_process_record(void)
+{
+    struct process_record *victim;
+    
+    if (!list_empty(&exited_lru)) {
+        victim = list_first_entry(&exited_lru, struct process_record, lru);
+        evicted_exited++;
+    } else {
+        victim = list_first_entry(&running_lru, struct process_record, lru);
+        evicted_running++;
+    }
+    
+    release_process_record(victim);
+}
+
+static int record_pool_reserve(unsigned int nr)
+{
+    return min_t(unsigned int, nr, RECORD_POOL_RESERVE);
+}
+
+/* Called with config_mutex held */
+static int set_record_capacity(unsigned int nr)
+{
+    spin_lock(&process_lock);
+    write_seqcount_begin(&stats_seq);
+    record_capacity = nr;
+    while (record_count > record_capacity)
+        evict_process_record();
+    write_seqcount_end(&stats_seq);
+    spin_unlock(&process_lock);
+    
+    return mempool_resize(record_pool, record_pool_reserve(nr));
+}
+
+/*
+ * Publish a new RUNNING record under its parent's record, if the parent
+ * is still tracked. Fails only if record_xa cannot grow, in which case
+ * the record was never visible. Called with process_lock held.
+ */
+static int add_process_record(struct process_record *record, const char *comm)
+{
+    struct process_record *parent;
+    
+    while (record_count >= record_capacity)
+        evict_process_record();
+    
+    record->seq = next_record_seq;
+    record->comm_id = intern_comm(comm);
+    if (xa_is_err(xa_store(&record_xa, record->seq, record, GFP_NOWAIT | __GFP_NOWARN))) {
+        put_comm(record->comm_id);
+        return -ENOMEM;
+    }
+    
+    next_record_seq++;
+    list_add_tail(&record->lru, &running_lru);
+    parent = find_running_by_pid(record->ppid);
+    if (parent && parent != record)
+        hlist_add_head_rcu(&record->sibling, &parent->children);
+    index_process_record(record);
+    record_count++;
+    WRITE_ONCE(record_generation, record_generation + 1);
+    return 0;
+}
+
+static unsigned int lifetime_bucket(u64 ns)
+{
+    unsigned int shift;
+    
+    if (ns < LIFETIME_SUB_BUCKETS)
+        return ns;
+    
+    shift = fls64(ns) - 1 - LIFETIME_SUB_BITS;
+    return (shift + 1) * LIFETIME_SUB_BUCKETS +
+           ((ns >> shift) & (LIFETIME_SUB_BUCKETS - 1));
+}
+
+/* Midpoint of a bucket, used as its representative value */
+static u64 lifetime_bucket_value(unsigned int idx)
+{
+    unsigned int shift;
+    
+    if (idx < LIFETIME_SUB_BUCKETS)
+        return idx;
+    
+    shift = idx / LIFETIME_SUB_BUCKETS - 1;
+    return ((u64)(LIFETIME_SUB_BUCKETS + idx % LIFETIME_SUB_BUCKETS) << shift) +
+           ((1ULL << shift) >> 1);
+}
+
+/* Called with preemption disabled */
+static void selfprof_record(int slot, u64 ns)
+{
+    struct selfprof_hist *hist = &this_cpu_ptr(selfprof)->hists[slot];
+    
+    hist->count++;
+    hist->sum_ns += ns;
+    if (ns > hist->max_ns)
+        hist->max_ns = ns;
+    hist->buckets[min_t(unsigned int, lifetime_bucket(ns), SELFPROF_BUCKETS - 1)]++;
+}
+
+/*
+ * Common body of every capture handler. With self-profiling off the
+ * static key leaves a straight jump past the clock reads.
+ */
+static void stage_process_event(int type, struct task_struct *task, pid_t ppid)
+{
+    u64 start;
+    
+    if (!static_branch_unlikely(&selfprof_key)) {
+        __stage_process_event(type, task, ppid);
+        return;
+    }
+    
+    start = local_clock();
+    __stage_process_event(type, task, ppid);
+    selfprof_record(type == PROCESS_EVENT_THREAD ? PROCESS_EVENT_FORK : type,
+                    local_clock() - start);
+}
+
+/* Called with process_lock held, inside stats_seq */
+static void record_lifetime(u64 ns, u32 weight)
+{
+    struct lifetime_hist *hist = &lifetime_hist;
+    
+    if (!hist->count || ns < hist->min_ns)
+        hist->min_ns = ns;
+    if (ns > hist->max_ns)
+        hist->max_ns = ns;
+    hist->count += weight;
+    hist->sum_ns += ns * weight;
+    hist->buckets[lifetime_bucket(ns)] += weight;
+}
+
+static void copy_lifetime_hist(struct lifetime_hist *copy)
+{
+    unsigned int seq;
+    
+    do {
+        seq = read_seqcount_begin(&stats_seq);
+        memcpy(copy, &lifetime_hist, sizeof(*copy));
+    } while (read_seqcount_retry(&stats_seq, seq));
+}
+
+/* Lifetime at or below which the given parts-per-10000 of samples fall */
+static u64 lifetime_percentile(const struct lifetime_hist *hist, unsigned int per10k)
+{
+    u64 rank = div64_u64(hist->count * per10k + 9999, 10000);
+    u64 seen = 0;
+    int i;
+    
+    for (i = 0; i < LIFETIME_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank)
+            return clamp(lifetime_bucket_value(i), hist->min_ns, hist->max_ns);
+    }
+    
+    return hist->max_ns;
+}
+
+/*
+ * Variance in us^2 from bucket midpoints. Squares of nanosecond values
+ * overflow u64 beyond ~4s, so the spread is computed in microseconds and
+ * saturates rather than wrapping.
+ */
+static u64 lifetime_variance_us(const struct lifetime_hist *hist, u64 mean_ns)
+{
+    u64 mean_us = div_u64(mean_ns, NSEC_PER_USEC);
+    u64 var = 0, term, d;
+    int i;
+    
+    for (i = 0; i < LIFETIME_BUCKETS; i++) {
+        if (!hist->buckets[i])
+            continue;
+        d = div_u64(lifetime_bucket_value(i), NSEC_PER_USEC);
+        d = d > mean_us ? d - mean_us : mean_us - d;
+        d = d > U32_MAX ? U64_MAX : d * d;
+        term = mul_u64_u64_div_u64(d, hist->buckets[i], hist->count);
+        var = var > U64_MAX - term ? U64_MAX : var + term;
+    }
+    
+    return var;
+}
+
+static void show_rate_row(struct seq_file *m, const char *name,
+                          const struct rate_history *h, int exited)
+{
+    static const unsigned int windows[] = { 1, 10, 60 };
+    const u64 *avg = exited ? h->avg_exited : h->avg_created;
+    u64 v;
+    int i;
+    
+    seq_printf(m, "%-8s", name);
+    for (i = 0; i < ARRAY_SIZE(windows); i++) {
+        v = rate_mean_x100(h, windows[i], exited);
+        seq_printf(m, " %8llu.%02llu", div_u64(v, 100), v % 100);
+    }
+    for (i = 0; i < 3; i++) {
+        v = (avg[i] * 100) >> RATE_FSHIFT;
+        seq_printf(m, " %8llu.%02llu", div_u64(v, 100), v % 100);
+    }
+    seq_printf(m, "\n");
+}
+
+static void show_governor_stats(struct seq_file *m)
+{
+    int mode = READ_ONCE(governor_mode);
+    unsigned long skipped = 0;
+    int cpu;
+    
+    for_each_possible_cpu(cpu)
+        skipped += READ_ONCE(per_cpu_ptr(&cpu_stats, cpu)->governor_skipped);
+    
+    seq_printf(m, "\n=== Capture Governor ===\n");
+    if (mode == GOVERNOR_SAMPLE)
+        seq_printf(m, "Mode: SAMPLING 1 in %u\n", 1U << READ_ONCE(governor_shift));
+    else
+        seq_printf(m, "Mode: %s\n", governor_mode_name(mode));
+    seq_printf(m, "In Mode For: %llu s\n",
+               div_u64(ktime_get_ns() - READ_ONCE(governor_since), NSEC_PER_SEC));
+    seq_printf(m, "Thresholds: sample above %u forks/sec, count only above %u (0 = off)\n",
+               READ_ONCE(governor_threshold), READ_ONCE(governor_count_only));
+    if (capture_mode == CAPTURE_KPROBE)
+        seq_printf(m, "Sampling needs the tracepoint backend; kprobe goes straight to count only\n");
+    seq_printf(m, "Events Skipped: %lu\n", skipped);
+    seq_printf(m, "Mode Changes: %lu\n", READ_ONCE(governor_switches));
+    seq_printf(m, "Event counts and rates are exact; lifetimes, usage and top commands\n"
+                  "are scaled up by the sampling rate while sampling\n");
+}
+
+static void show_rate_stats(struct seq_file *m)
+{
+    struct rate_history *h;
+    
+    seq_printf(m, "\n=== Event Rates (per second) ===\n");
+    
+    h = snapshot_rates();
+    if (!h) {
+        seq_printf(m, "(unavailable: out of memory)\n");
+        return;
+    }
+    
+    seq_printf(m, "%-8s %11s %11s %11s %11s %11s %11s\n", "",
+               "1s", "10s", "60s", "avg 1m", "avg 5m", "avg 15m");
+    show_rate_row(m, "Created", h, 0);
+    show_rate_row(m, "Exited", h, 1);
+    if (h->seconds < 60)
+        seq_printf(m, "(%lu seconds of history so far)\n", h->seconds);
+    
+    kfree(h);
+}
+
+static void show_lifetime_stats(struct seq_file *m)
+{
+    struct lifetime_hist *hist;
+    u64 mean, var;
+    
+    seq_printf(m, "\n=== Lifetime Distribution ===\n");
+    
+    hist = kmalloc(sizeof(*hist), GFP_KERNEL);
+    if (!hist) {
+        seq_printf(m, "(unavailable: out of memory)\n");
+        return;
+    }
+    
+    copy_lifetime_hist(hist);
+    seq_printf(m, "Samples: %llu\n", hist->count);
+    
+    if (hist->count) {
+        mean = div64_u64(hist->sum_ns, hist->count);
+        var = lifetime_variance_us(hist, mean);
+        seq_printf(m, "Min: %llu ns\n", hist->min_ns);
+        seq_printf(m, "Max: %llu ns\n", hist->max_ns);
+        seq_printf(m, "Mean: %llu ns\n", mean);
+        seq_printf(m, "Variance: %llu us^2 (stddev %llu us)\n", var, int_sqrt64(var));
+        seq_printf(m, "p50: %llu ns\n", lifetime_percentile(hist, 5000));
+        seq_printf(m, "p90: %llu ns\n", lifetime_percentile(hist, 9000));
+        seq_printf(m, "p99: %llu ns\n", lifetime_percentile(hist, 9900));
+        seq_printf(m, "p999: %llu ns\n", lifetime_percentile(hist, 9990));
+    }
+    
+    kfree(hist);
+}
+
+/* weight scales a sampled exit back up to the exits it stands for */
+static void add_usage(struct usage_totals *totals, const struct pm_usage *usage, u32 weight)
+{
+    totals->exits += weight;
+    totals->sum.utime_ns += usage->utime_ns * weight;
+    totals->sum.stime_ns += usage->stime_ns * weight;
+    totals->sum.maxrss_kb += usage->maxrss_kb * weight;
+    totals->sum.nvcsw += usage->nvcsw * weight;
+    totals->sum.nivcsw += usage->nivcsw * weight;
+    totals->sum.min_flt += usage->min_flt * weight;
+    totals->sum.maj_flt += usage->maj_flt * weight;
+    totals->sum.read_bytes += usage->read_bytes * weight;
+    totals->sum.write_bytes += usage->write_bytes * weight;
+}
+
+/* Called with process_lock held */
+static struct usage_totals *comm_usage_totals(const char *comm)
+{
+    struct comm_usage *cu;
+    size_t len = strnlen(comm, TASK_COMM_LEN);
+    u32 hash = full_name_hash(NULL, comm, len);
+    
+    hash_for_each_possible(usage_hash, cu, node, hash) {
+        if (strncmp(cu->comm, comm, TASK_COMM_LEN) == 0)
+            return &cu->totals;
+    }
+    
+    if (usage_comms >= USAGE_COMMS_MAX)
+        return &usage_other;
+    
+    cu = kzalloc(sizeof(*cu), GFP_NOWAIT | __GFP_NOWARN);
+    if (!cu)
+        return &usage_other;
+    
+    memcpy(cu->comm, comm, len);
+    hash_add_rcu(usage_hash, &cu->node, hash);
+    usage_comms++;
+    return &cu->totals;
+}
+
+/* Called with process_lock held */
+static void account_exit_usage(const struct process_event *event)
+{
+    add_usage(&stats.usage, &event->usage, event->weight);
+    add_usage(comm_usage_totals(event->comm), &event->usage, event->weight);
+}
+
+/* Called with process_lock held, or once nothing else can see the table */
+static void clear_comm_usage(void)
+{
+    struct comm_usage *cu;
+    struct hlist_node *tmp;
+    int bkt;
+    
+    hash_for_each_safe(usage_hash, bkt, tmp, cu, node) {
+        hash_del_rcu(&cu->node);
+        kfree_rcu(cu, rcu);
+    }
+    usage_comms = 0;
+    memset(&usage_other, 0, sizeof(usage_other));
+}
+
+/* Called with process_lock held */
+static struct process_record *mark_process_exit(const struct process_event *event)
+{
+    struct process_record *record;
+    struct record_extra *extra;
+    
+    /* A record started after the exit belongs to a later use of the pid */
+    record = find_running_by_pid(event->pid);
+    if (record && record->start_ns > event->timestamp)
+        record = NULL;
+    if (record) {
+        u64 lifetime_ns = event->timestamp - record->start_ns;
+        u32 cpu_ms = min_t(u64, div_u64(event->usage.utime_ns + event->usage.stime_ns,
+                                        NSEC_PER_MSEC), U32_MAX);
+        u32 maxrss_kb = min_t(u64, event->usage.maxrss_kb, U32_MAX);
+        
+        WRITE_ONCE(record->exit_code, event->exit_code);
+        extra = cpu_ms || maxrss_kb ? get_record_extra(record) : NULL;
+        if (extra) {
+            WRITE_ONCE(extra->cpu_ms, cpu_ms);
+            WRITE_ONCE(extra->maxrss_kb, maxrss_kb);
+        }
+        /* Readers under RCU see the exit fields once lifetime_ms is set */
+        smp_store_release(&record->lifetime_ms,
+                          (u32)min_t(u64, div_u64(lifetime_ns, NSEC_PER_MSEC), RECORD_RUNNING - 1));
+        list_move_tail(&record->lru, &exited_lru);
+        WRITE_ONCE(record_generation, record_generation + 1);
+        
+        /* A weight 0 exit closes a record kept at full rate */
+        record_lifetime(lifetime_ns, event->weight ?: 1);
+    }
+    
+    return record;
+}
+
+/*
+ * The fork handler names a record after the parent, so an exec replaces
+ * the name with the one the new image runs under. Called with
+ * process_lock held.
+ */
+static void mark_process_exec(const struct process_event *event)
+{
+    struct process_record *record;
+    struct record_extra *extra;
+    u16 comm_id;
+    
+    record = find_running_by_pid(event->pid);
+    if (!record)
+        return;
+    
+    comm_id = intern_comm(event->comm);
+    if (comm_id) {
+        put_comm(record->comm_id);
+        WRITE_ONCE(record->comm_id, comm_id);
+    }
+    extra = get_record_extra(record);
+    if (extra)
+        WRITE_ONCE(extra->execs, extra->execs + 1);
+    WRITE_ONCE(record_generation, record_generation + 1);
+}
+
+/* Count a new thread against its group's record. Called with process_lock held */
+static void mark_thread_create(const struct process_event *event)
+{
+    struct process_record *record;
+    struct record_extra *extra;
+    
+    record = find_running_by_pid(event->pid);
+    if (!record)
+        return;
+    
+    extra = get_record_extra(record);
+    if (!extra)
+        return;
+    WRITE_ONCE(extra->threads, extra->threads + 1);
+    if (event->group_threads > extra->peak_threads)
+        WRITE_ONCE(extra->peak_threads, event->group_threads);
+}
+
+static void account_summary_event(const struct process_event *event)
+{
+    int i;
+    
+    if (event->type == PROCESS_EVENT_EXIT) {
+        summary.exits++;
+        return;
+    }
+    
+    if (event->type == PROCESS_EVENT_EXEC)
+        summary.execs++;
+    else
+        summary.forks++;
+    
+    for (i = 0; i < summary.nr_comms; i++) {
+        if (memcmp(summary.comms[i].comm, event->comm, TASK_COMM_LEN) == 0) {
+            summary.comms[i].count++;
+            return;
+        }
+    }
+    
+    if (summary.nr_comms < SUMMARY_TOP_SLOTS) {
+        memcpy(summary.comms[i].comm, event->comm, TASK_COMM_LEN);
+        summary.comms[i].count = 1;
+        summary.nr_comms++;
+    }
+}
+
+static int compare_comm_counts(const void *a, const void *b)
+{
+    const struct comm_count *x = a, *y = b;
+    
+    if (x->count > y->count)
+        return -1;
+    return x->count < y->count;
+}
+
+static void emit_event_summary(void)
+{
+    char top[SUMMARY_TOP_SHOWN * (TASK_COMM_LEN + 24)];
+    unsigned long seconds;
+    int len = 0;
+    int i;
+    
+    seconds = max_t(unsigned long, (jiffies - summary.start) / HZ, 1);
+    
+    if (summary.forks || summary.exits || summary.execs || summary.suppressed) {
+        sort(summary.comms, summary.nr_comms, sizeof(struct comm_count),
+             compare_comm_counts, NULL);
+        
+        top[0] = '\0';
+        for (i = 0; i < summary.nr_comms && i < SUMMARY_TOP_SHOWN; i++) {
+            len += scnprintf(top + len, sizeof(top) - len, "%s%s(%lu)",
+                             i ? " " : "", summary.comms[i].comm, summary.comms[i].count);
+        }
+        
+        printk(KERN_INFO "process_monitor: last %lus - forks: %lu (%lu/s), exits: %lu (%lu/s), "
+               "execs: %lu, suppressed: %lu, top: %s\n",
+               seconds, summary.forks, summary.forks / seconds,
+               summary.exits, summary.exits / seconds, summary.execs,
+               summary.suppressed, len ? top : "-");
+    }
+    
+    memset(&summary, 0, sizeof(summary));
+    summary.start = jiffies;
+}
+
+static void report_staged_event(const struct drain_slot *slot)
+{
+    if (!__ratelimit(&event_ratelimit)) {
+        summary.suppressed++;
+        total_suppressed++;
+        return;
+    }
+    
+    if (slot->event.type == PROCESS_EVENT_FORK) {
+        printk(KERN_INFO "process_monitor: Process created - PID: %d, PPID: %d, COMM: %s\n", 
+               slot->event.pid, slot->event.ppid, slot->event.comm);
+    } else {
+        printk(KERN_INFO "process_monitor: Process exited - PID: %d, Exit Code: %d, Lifetime: %lu ms\n", 
+               slot->event.pid, slot->event.exit_code, slot->lifetime);
+    }
+}
+
+static void topcomm_reset(void)
+{
+    memset(&topcomm, 0, sizeof(topcomm));
+    memset(topcomm.buckets, TOPCOMM_NONE, sizeof(topcomm.buckets));
+}
+
+static void topcomm_swap(unsigned int a, unsigned int b)
+{
+    u8 x = topcomm.heap[a], y = topcomm.heap[b];
+    
+    topcomm.heap[a] = y;
+    topcomm.heap[b] = x;
+    topcomm.counters[y].heap_pos = a;
+    topcomm.counters[x].heap_pos = b;
+}
+
+static u64 topcomm_heap_count(unsigned int pos)
+{
+    return topcomm.counters[topcomm.heap[pos]].count;
+}
+
+static void topcomm_sift_up(unsigned int pos)
+{
+    while (pos && topcomm_heap_count((pos - 1) / 2) > topcomm_heap_count(pos)) {
+        topcomm_swap(pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+}
+
+static void topcomm_sift_down(unsigned int pos)
+{
+    unsigned int child;
+    
+    while ((child = 2 * pos + 1) < topcomm.nr) {
+        if (child + 1 < topcomm.nr &&
+            topcomm_heap_count(child + 1) < topcomm_heap_count(child))
+            child++;
+        if (topcomm_heap_count(pos) <= topcomm_heap_count(child))
+            break;
+        topcomm_swap(pos, child);
+        pos = child;
+    }
+}
+
+static void topcomm_unlink(u8 idx)
+{
+    u8 *link = &topcomm.buckets[topcomm.counters[idx].hash & (TOPCOMM_HASH_SIZE - 1)];
+    
+    while (*link != idx)
+        link = &topcomm.counters[*link].next;
+    *link = topcomm.counters[idx].next;
+}
+
+/*
+ * Count weight forks by comm, the name of the forking task. A name that
+ * is not tracked takes over the smallest counter and inherits its count
+ * as error, so every count overestimates by at most total / TOPCOMM_SLOTS.
+ * O(log TOPCOMM_SLOTS). Called with process_lock held.
+ */
+static void topcomm_count(const char *comm, u32 weight)
+{
+    size_t len = strnlen(comm, TASK_COMM_LEN);
+    u32 hash = full_name_hash(NULL, comm, len);
+    u8 *bucket = &topcomm.buckets[hash & (TOPCOMM_HASH_SIZE - 1)];
+    struct topcomm_counter *c;
+    u8 idx;
+    
+    topcomm.total += weight;
+    
+    for (idx = *bucket; idx != TOPCOMM_NONE; idx = c->next) {
+        c = &topcomm.counters[idx];
+        if (c->hash == hash && strncmp(c->comm, comm, TASK_COMM_LEN) == 0) {
+            c->count += weight;
+            topcomm_sift_down(c->heap_pos);
+            return;
+        }
+    }
+    
+    if (topcomm.nr < TOPCOMM_SLOTS) {
+        idx = topcomm.nr++;
+        c = &topcomm.counters[idx];
+        c->count = weight;
+        c->error = 0;
+        c->heap_pos = idx;
+        topcomm.heap[idx] = idx;
+        topcomm_sift_up(idx);
+    } else {
+        idx = topcomm.heap[0];
+        c = &topcomm.counters[idx];
+        topcomm_unlink(idx);
+        c->error = c->count;
+        c->count += weight;
+        topcomm_sift_down(0);
+    }
+    
+    memset(c->comm, 0, TASK_COMM_LEN);
+    memcpy(c->comm, comm, len);
+    c->hash = hash;
+    c->next = *bucket;
+    *bucket = idx;
+}
+
+/*
+ * /proc readers never take process_lock, so the worst wait seen here is
+ * the bound on how long control writes can hold up event processing.
+ * Called with process_lock held.
+ */
+static void account_lock_timing(u64 wait_ns, u64 hold_ns)
+{
+    writer_timing.batches++;
+    writer_timing.total_wait_ns += wait_ns;
+    writer_timing.total_hold_ns += hold_ns;
+    if (wait_ns > writer_timing.max_wait_ns)
+        writer_timing.max_wait_ns = wait_ns;
+    if (hold_ns > writer_timing.max_hold_ns)
+        writer_timing.max_hold_ns = hold_ns;
+}
+
+/*
+ * Apply one drained batch to the store. Records for fork events are
+ * allocated up front so that process_lock is taken once per batch.
+ * Thread events are used up here; the rest are moved to the front of
+ * slots for publishing and their number returned.
+ */
+/*
+ * Staging rings are drained one CPU at a time, so an exit can reach the
+ * store a drain before the fork it closes, which sat on another CPU's
+ * ring. Unmatched exits are kept for one more drain and retried after
+ * its events. Called with process_lock held.
+ */
+static void defer_exit(const struct drain_slot *slot)
+{
+    if (nr_deferred_exits < DEFERRED_EXITS_MAX)
+        deferred_exits[nr_deferred_exits++].event = slot->event;
+}
+
+/* Called with process_lock held */
+static void retry_deferred_exits(unsigned int nr)
+{
+    struct drain_slot *slot;
+    struct process_record *record;
+    unsigned int i;
+    
+    for (i = 0; i < nr; i++) {
+        slot = &deferred_exits[i];
+        slot->report = 0;
+        record = mark_process_exit(&slot->event);
+        if (record) {
+            slot->lifetime = record->lifetime_ms;
+            slot->report = verbose_events && process_matches_filter(record);
+        }
+    }
+}
+
+/* Report the retried exits that matched and drop them all */
+static void finish_deferred_exits(unsigned int nr)
+{
+    unsigned int i;
+    
+    for (i = 0; i < nr; i++) {
+        if (deferred_exits[i].report)
+            report_staged_event(&deferred_exits[i]);
+    }
+    
+    nr_deferred_exits -= nr;
+    memmove(deferred_exits, deferred_exits + nr, nr_deferred_exits * sizeof(*deferred_exits));
+}
+
+static unsigned int apply_staged_events(struct drain_slot *slots, unsigned int nr)
+{
+    struct drain_slot *slot;
+    struct process_record *record;
+    u64 start, locked, end;
+    unsigned int i, kept = 0;
+    unsigned int retry = nr_deferred_exits;
+    
+    for (i = 0; i < nr; i++) {
+        slot = &slots[i];
+        slot->record = NULL;
+        slot->report = 0;
+        if (slot->event.type == PROCESS_EVENT_FORK) {
+            slot->record = alloc_process_record(&slot->event);
+        }
+    }
+    
+    start = ktime_get_ns();
+    spin_lock(&process_lock);
+    locked = ktime_get_ns();
+    write_seqcount_begin(&stats_seq);
+    
+    for (i = 0; i < nr; i++) {
+        slot = &slots[i];
+        if (slot->event.type == PROCESS_EVENT_FORK) {
+            topcomm_count(slot->event.comm, slot->event.weight);
+            if (!slot->record)
+                continue;
+            if (add_process_record(slot->record, slot->event.comm) < 0) {
+                mempool_free(slot->record, record_pool);
+                slot->record = NULL;
+                alloc_failures++;
+                continue;
+            }
+            slot->report = verbose_events && process_matches_filter(slot->record);
+        } else if (slot->event.type == PROCESS_EVENT_EXIT) {
+            if (slot->event.weight)
+                account_exit_usage(&slot->event);
+            record = mark_process_exit(&slot->event);
+            if (record) {
+                slot->lifetime = record->lifetime_ms;
+                slot->report = verbose_events && process_matches_filter(record);
+            } else {
+                defer_exit(slot);
+            }
+        } else if (slot->event.type == PROCESS_EVENT_EXEC) {
+            mark_process_exec(&slot->event);
+        } else if (slot->event.type == PROCESS_EVENT_THREAD) {
+            mark_thread_create(&slot->event);
+        }
+    }
+    retry_deferred_exits(retry);
+    
+    end = ktime_get_ns();
+    account_lock_timing(locked - start, end - locked);
+    if (static_branch_unlikely(&selfprof_key)) {
+        selfprof_record(SELFPROF_LOCK_WAIT, locked - start);
+        selfprof_record(SELFPROF_LOCK_HOLD, end - locked);
+    }
+    write_seqcount_end(&stats_seq);
+    spin_unlock(&process_lock);
+    
+    finish_deferred_exits(retry);
+    for (i = 0; i < nr; i++) {
+        slot = &slots[i];
+        if (slot->event.type == PROCESS_EVENT_THREAD)
+            continue;
+        account_summary_event(&slot->event);
+        if (slot->report)
+            report_staged_event(slot);
+        if (kept != i)
+            slots[kept] = *slot;
+        kept++;
+    }
+    
+    return kept;
+}
+
+static int compare_drain_slots(const void *a, const void *b)
+{
+    const struct drain_slot *x = a, *y = b;
+    
+    if (x->event.timestamp < y->event.timestamp)
+        return -1;
+    return x->event.timestamp > y->event.timestamp;
+}
+
+static void fill_pm_event(struct pm_event *e, const struct process_event *event)
+{
+    e->timestamp_ns = event->timestamp;
+    e->pid = event->pid;
+    e->ppid = event->ppid;
+    e->exit_code = event->exit_code;
+    e->type = event->type;
+    memcpy(e->comm, event->comm, sizeof(e->comm));
+    e->usage = event->usage;
+}
+
+/*
+ * The consumer's tail, clamped to [head - nr_events, head]. It is the
+ * only header field the kernel reads back, and userspace may have
+ * stored anything there.
+ */
+static u64 ring_consumer_tail(u64 head)
+{
+    u64 tail = smp_load_acquire(&event_ring->tail);
+    
+    if (tail > head)
+        return head;
+    if (head - tail > ring_nr_events)
+        return head - ring_nr_events;
+    return tail;
+}
+
+/*
+ * Copy a drained batch into the mmap ring, in capture order. The drain
+ * worker is the only producer; an event that finds the ring full is
+ * dropped and counted in the header so the consumer can see the gap.
+ */
+static void publish_ring_events(const struct drain_slot *slots, unsigned int nr)
+{
+    u64 head, tail;
+    unsigned int i;
+    
+    spin_lock(&ring_lock);
+    
+    if (!ring_active) {
+        spin_unlock(&ring_lock);
+        return;
+    }
+    
+    head = ring_head;
+    tail = ring_consumer_tail(head);
+    
+    for (i = 0; i < nr; i++) {
+        if (head - tail >= ring_nr_events) {
+            ring_overruns += nr - i;
+            WRITE_ONCE(event_ring->overruns, ring_overruns);
+            break;
+        }
+        
+        fill_pm_event(&ring_slots[head & (ring_nr_events - 1)], &slots[i].event);
+        head++;
+    }
+    
+    if (head != ring_head) {
+        WRITE_ONCE(ring_head, head);
+        smp_store_release(&event_ring->head, head);
+        wake_up_interruptible(&ring_wait);
+    }
+    
+    spin_unlock(&ring_lock);
+}
+
+static const struct genl_multicast_group pm_genl_mcgrps[] = {
+    { .name = PM_GENL_MCGRP },
+};
+
+static struct genl_family pm_genl_family __ro_after_init = {
+    .name = PM_GENL_NAME,
+    .version = PM_GENL_VERSION,
+    .maxattr = PM_ATTR_MAX,
+    .module = THIS_MODULE,
+    .mcgrps = pm_genl_mcgrps,
+    .n_mcgrps = ARRAY_SIZE(pm_genl_mcgrps),
+};
+
+/*
+ * Send the pending batch as one message. Events that cannot be sent still
+ * use up their sequence numbers, so listeners see the gap.
+ */
+static void flush_netlink_batch(void)
+{
+    unsigned int nr = netlink_nr_pending;
+    size_t len = nr * sizeof(struct pm_event);
+    struct sk_buff *skb;
+    void *hdr;
+    int ret;
+    
+    if (!nr)
+        return;
+    netlink_nr_pending = 0;
+    
+    skb = genlmsg_new(nla_total_size_64bit(sizeof(u64)) * 2 + nla_total_size(sizeof(u32)) +
+                      nla_total_size(len), GFP_KERNEL);
+    if (!skb)
+        goto lost;
+    
+    hdr = genlmsg_put(skb, 0, 0, &pm_genl_family, 0, PM_CMD_EVENTS);
+    if (!hdr ||
+        nla_put_u64_64bit(skb, PM_ATTR_SEQ, netlink_next_seq - nr, PM_ATTR_PAD) ||
+        nla_put_u32(skb, PM_ATTR_COUNT, nr) ||
+        nla_put_u64_64bit(skb, PM_ATTR_LOST, netlink_lost, PM_ATTR_PAD) ||
+        nla_put(skb, PM_ATTR_EVENTS, len, netlink_pending)) {
+        nlmsg_free(skb);
+        goto lost;
+    }
+    genlmsg_end(skb, hdr);
+    
+    /* -ESRCH only means the last listener left */
+    ret = genlmsg_multicast(&pm_genl_family, skb, 0, 0, GFP_KERNEL);
+    if (ret < 0 && ret != -ESRCH)
+        goto lost;
+    
+    netlink_messages++;
+    return;
+
+lost:
+    netlink_lost += nr;
+}
+
+/*
+ * Append a drained batch to the netlink stream, sending a message each
+ * time netlink_batch events are pending. A partial batch goes out once
+ * it is netlink_flush_ms old; the drain worker checks on every run, so
+ * the hold time is rounded up to STAGING_DRAIN_INTERVAL_MS. Nothing is
+ * buffered while the group has no listeners.
+ */
+static void publish_netlink_events(const struct drain_slot *slots, unsigned int nr)
+{
+    unsigned int batch = clamp_t(unsigned int, READ_ONCE(netlink_batch), 1, NETLINK_BATCH_MAX);
+    unsigned int i;
+    
+    if (!genl_has_listeners(&pm_genl_family, &init_net, 0)) {
+        netlink_nr_pending = 0;
+        return;
+    }
+    
+    for (i = 0; i < nr; i++) {
+        if (!netlink_nr_pending)
+            netlink_batch_start = jiffies;
+        fill_pm_event(&netlink_pending[netlink_nr_pending++], &slots[i].event);
+        netlink_next_seq++;
+        if (netlink_nr_pending >= batch)
+            flush_netlink_batch();
+    }
+    
+    if (netlink_nr_pending &&
+        time_after_eq(jiffies, netlink_batch_start +
+                               msecs_to_jiffies(READ_ONCE(netlink_flush_ms))))
+        flush_netlink_batch();
+}
+
+/*
+ * Pull up to drain_quota events from every CPU, restore global order by
+ * capture timestamp and apply them. Re-queues itself immediately while
+ * any buffer still holds events, otherwise at the regular interval.
+ */
+static void drain_staging_buffers(struct work_struct *work)
+{
+    unsigned int nr = 0;
+    int pending = 0;
+    int cpu;
+    
+    for_each_possible_cpu(cpu) {
+        struct staging_buffer *buf = per_cpu_ptr(&staging_buffers, cpu);
+        unsigned int head = smp_load_acquire(&buf->head);
+        unsigned int tail = buf->tail;
+        unsigned int taken = 0;
+        
+        while (tail != head && taken < drain_quota) {
+            drain_slots[nr++].event = buf->events[tail & (STAGING_BUFFER_SIZE - 1)];
+            tail++;
+            taken++;
+        }
+        
+        smp_store_release(&buf->tail, tail);
+        if (tail != head)
+            pending = 1;
+    }
+    
+    if (nr) {
+        sort(drain_slots, nr, sizeof(struct drain_slot), compare_drain_slots, NULL);
+        nr = apply_staged_events(drain_slots, nr);
+        publish_ring_events(drain_slots, nr);
+    }
+    publish_netlink_events(drain_slots, nr);
+    
+    if (summary_interval &&
+        time_after_eq(jiffies, summary.start + (unsigned long)summary_interval * HZ))
+        emit_event_summary();
+    
+    queue_delayed_work(system_wq, &drain_work,
+                       pending ? 0 : msecs_to_jiffies(STAGING_DRAIN_INTERVAL_MS));
+}
+
+static void free_staging_buffers(void)
+{
+    int cpu;
+    
+    for_each_possible_cpu(cpu) {
+        struct staging_buffer *buf = per_cpu_ptr(&staging_buffers, cpu);
+        kvfree(buf->events);
+        buf->events = NULL;
+    }
+    
+    kvfree(drain_slots);
+    drain_slots = NULL;
+    kvfree(deferred_exits);
+    deferred_exits = NULL;
+}
+
+static int alloc_event_ring(void)
+{
+    unsigned int nr = roundup_pow_of_two(clamp_t(unsigned int, ring_events,
+                                                 EVENT_RING_MIN_EVENTS, EVENT_RING_MAX_EVENTS));
+    unsigned long data_offset = PAGE_ALIGN(sizeof(struct pm_ring_header));
+    
+    ring_size = data_offset + PAGE_ALIGN(nr * sizeof(struct pm_event));
+    event_ring = vmalloc_user(ring_size);
+    if (!event_ring)
+        return -ENOMEM;
+    
+    event_ring->version = PM_RING_VERSION;
+    event_ring->event_size = sizeof(struct pm_event);
+    event_ring->nr_events = nr;
+    event_ring->data_offset = data_offset;
+    ring_nr_events = nr;
+    ring_slots = (struct pm_event *)((char *)event_ring + data_offset);
+    
+    return 0;
+}
+
+static void free_event_ring(void)
+{
+    vfree(event_ring);
+    event_ring = NULL;
+}
+
+/*
+ * Records come from a dedicated slab cache backed by a mempool holding
+ * up to RECORD_POOL_RESERVE preallocated objects, so the store can be
+ * refilled under memory pressure without failing every allocation.
+ * Extras get a cache of their own so they are not rounded up to the
+ * next kmalloc size.
+ */
+static int create_record_pool(void)
+{
+    BUILD_BUG_ON(sizeof(struct process_record) > RECORD_SIZE_MAX);
+    
+    /* No cache-line alignment: it would round 80-byte records up to 128 */
+    record_cache = kmem_cache_create(RECORD_CACHE_NAME, sizeof(struct process_record),
+                                     0, 0, NULL);
+    if (!record_cache)
+        return -ENOMEM;
+    
+    extra_cache = kmem_cache_create(EXTRA_CACHE_NAME, sizeof(struct record_extra),
+                                    0, 0, NULL);
+    if (!extra_cache) {
+        kmem_cache_destroy(record_cache);
+        record_cache = NULL;
+        return -ENOMEM;
+    }
+    
+    record_pool = mempool_create_slab_pool(record_pool_reserve(record_capacity), record_cache);
+    if (!record_pool) {
+        kmem_cache_destroy(extra_cache);
+        kmem_cache_destroy(record_cache);
+        extra_cache = NULL;
+        record_cache = NULL;
+        return -ENOMEM;
+    }
+    
+    return 0;
+}
+
+static void destroy_record_pool(void)
+{
+    mempool_destroy(record_pool);
+    kmem_cache_destroy(extra_cache);
+    kmem_cache_destroy(record_cache);
+    record_pool = NULL;
+    extra_cache = NULL;
+    record_cache = NULL;
+}
+
+static int alloc_staging_buffers(void)
+{
+    int cpu;
+    
+    for_each_possible_cpu(cpu) {
+        struct staging_buffer *buf = per_cpu_ptr(&staging_buffers, cpu);
+        buf->events = kvmalloc_node(STAGING_BUFFER_SIZE * sizeof(struct process_event),
+                                    GFP_KERNEL, cpu_to_node(cpu));
+        if (!buf->events)
+            goto fail;
+        buf->head = 0;
+        buf->tail = 0;
+        buf->dropped = 0;
+    }
+    
+    drain_quota = max_t(unsigned int, DRAIN_BATCH_MAX / num_possible_cpus(), 1);
+    drain_slots = kvmalloc_array(drain_quota * num_possible_cpus(),
+                                 sizeof(struct drain_slot), GFP_KERNEL);
+    if (!drain_slots)
+        goto fail;
+    
+    deferred_exits = kvmalloc_array(DEFERRED_EXITS_MAX, sizeof(struct drain_slot), GFP_KERNEL);
+    if (!deferred_exits)
+        goto fail;
+    nr_deferred_exits = 0;
+    
+    return 0;
+
+fail:
+    free_staging_buffers();
+    return -ENOMEM;
+}
+
+/*
+ * With thread_groups set, a clone that only adds a thread to the
+ * caller's group is staged against the group instead of as a fork. The
+ * kprobe fires before the clone, so only the clone flags tell. Both
+ * _do_fork and kernel_clone take struct kernel_clone_args on every
+ * kernel that has proc_ops.
+ */
+static int kprobe_fork_type(struct pt_regs *regs)
+{
+    struct kernel_clone_args *args;
+    
+    if (!thread_groups)
+        return PROCESS_EVENT_FORK;
+    
+    args = (struct kernel_clone_args *)regs_get_kernel_argument(regs, 0);
+    return args->flags & CLONE_THREAD ? PROCESS_EVENT_THREAD : PROCESS_EVENT_FORK;
+}
+
+/*
+ * kprobe backend. The probe fires in the parent before the child exists,
+ * so the record carries the caller's pid.
+ */
+static int pre_handler_fork(struct kprobe *p, struct pt_regs *regs)
+{
+    struct task_struct *task = current;
+    
+    if (!monitoring_enabled)
+        return 0;
+    
+    stage_process_event(kprobe_fork_type(regs), task, task->parent->pid);
+    return 0;
+}
+
+static int pre_handler_exit(struct kprobe *p, struct pt_regs *regs)
+{
+    struct task_struct *task = current;
+    
+    if (!monitoring_enabled)
+        return 0;
+    
+    stage_process_event(PROCESS_EVENT_EXIT, task, task->parent->pid);
+    return 0;
+}
+
+/*
+ * setup_new_exec runs once the exec is past the point of no return and
+ * begin_new_exec has already renamed the task, so current carries the
+ * new image's name, as at the sched_process_exec tracepoint.
+ */
+static int pre_handler_exec(struct kprobe *p, struct pt_regs *regs)
+{
+    struct task_struct *task = current;
+    
+    if (!monitoring_enabled)
+        return 0;
+    
+    stage_process_event(PROCESS_EVENT_EXEC, task, task->parent->pid);
+    return 0;
+}
+
+/*
+ * Tracepoint backend. sched_process_fork runs once the child exists, so
+ * the record gets the child's pid with the real parent as ppid.
+ */
+static void probe_sched_process_fork(void *data, struct task_struct *parent,
+                                     struct task_struct *child)
+{
+    int type = thread_groups && !thread_group_leader(child) ?
+               PROCESS_EVENT_THREAD : PROCESS_EVENT_FORK;
+    
+    if (!monitoring_enabled)
+        return;
+    
+    stage_process_event(type, child, parent->pid);
+}
+
+static void probe_sched_process_exec(void *data, struct task_struct *p,
+                                     pid_t old_pid, struct linux_binprm *bprm)
+{
+    if (!monitoring_enabled)
+        return;
+    
+    stage_process_event(PROCESS_EVENT_EXEC, p, p->real_parent->pid);
+}
+
+static void probe_sched_process_exit(void *data, struct task_struct *p)
+{
+    if (!monitoring_enabled)
+        return;
+    
+    stage_process_event(PROCESS_EVENT_EXIT, p, p->real_parent->pid);
+}
+
+static struct capture_tracepoint capture_tracepoints[] = {
+    { .name = "sched_process_fork", .probe = probe_sched_process_fork },
+    { .name = "sched_process_exec", .probe = probe_sched_process_exec },
+    { .name = "sched_process_exit", .probe = probe_sched_process_exit },
+};
+
+static int register_kprobe_backend(void)
+{
+    int ret;
+    
+    kp_do_fork.symbol_name = "_do_fork";
+    kp_do_fork.pre_handler = pre_handler_fork;
+    ret = register_kprobe(&kp_do_fork);
+    if (ret < 0) {
+        kp_do_fork.symbol_name = "kernel_clone";
+        ret = register_kprobe(&kp_do_fork);
+        if (ret < 0) {
+            printk(KERN_ERR "process_monitor: Failed to register fork kprobe: %d\n", ret);
+            return ret;
+        }
+    }
+    
+    kp_do_exit.symbol_name = "do_exit";
+    kp_do_exit.pre_handler = pre_handler_exit;
+    ret = register_kprobe(&kp_do_exit);
+    if (ret < 0) {
+        printk(KERN_ERR "process_monitor: Failed to register exit kprobe: %d\n", ret);
+        unregister_kprobe(&kp_do_fork);
+        return ret;
+    }
+    
+    /* Without it records keep the forking parent's name and count no execs */
+    kp_exec.symbol_name = "setup_new_exec";
+    kp_exec.pre_handler = pre_handler_exec;
+    ret = register_kprobe(&kp_exec);
+    if (ret < 0)
+        printk(KERN_WARNING "process_monitor: Exec kprobe not registered (%d), execs not tracked\n", ret);
+    kp_exec_registered = ret == 0;
+    
+    return 0;
+}
+
+static void unregister_kprobe_backend(void)
+{
+    unregister_kprobe(&kp_do_fork);
+    unregister_kprobe(&kp_do_exit);
+    if (kp_exec_registered)
+        unregister_kprobe(&kp_exec);
+}
+
+/* The sched tracepoints are not exported to modules; look them up by name */
+static void lookup_capture_tracepoint(struct tracepoint *tp, void *priv)
+{
+    int i;
+    
+    for (i = 0; i < ARRAY_SIZE(capture_tracepoints); i++) {
+        if (strcmp(tp->name, capture_tracepoints[i].name) == 0)
+            capture_tracepoints[i].tp = tp;
+    }
+}
+
+static void unregister_tracepoint_backend(void)
+{
+    int i;
+    
+    for (i = 0; i < ARRAY_SIZE(capture_tracepoints); i++) {
+        if (capture_tracepoints[i].registered) {
+            tracepoint_probe_unregister(capture_tracepoints[i].tp,
+                                        capture_tracepoints[i].probe, NULL);
+            capture_tracepoints[i].registered = 0;
+        }
+    }
+    
+    tracepoint_synchronize_unregister();
+}
+
+static int register_tracepoint_backend(void)
+{
+    int ret;
+    int i;
+    
+    for_each_kernel_tracepoint(lookup_capture_tracepoint, NULL);
+    
+    for (i = 0; i < ARRAY_SIZE(capture_tracepoints); i++) {
+        if (!capture_tracepoints[i].tp) {
+            printk(KERN_ERR "process_monitor: Tracepoint %s not found\n",
+                   capture_tracepoints[i].name);
+            unregister_tracepoint_backend();
+            return -ENOENT;
+        }
+        
+        ret = tracepoint_probe_register(capture_tracepoints[i].tp,
+                                        capture_tracepoints[i].probe, NULL);
+        if (ret < 0) {
+            printk(KERN_ERR "process_monitor: Failed to register tracepoint %s: %d\n",
+                   capture_tracepoints[i].name, ret);
+            unregister_tracepoint_backend();
+            return ret;
+        }
+        capture_tracepoints[i].registered = 1;
+    }
+    
+    return 0;
+}
+
+static int register_capture_backend(void)
+{
+    int ret;
+    
+    if (strcmp(capture_backend, "kprobe") == 0) {
+        capture_mode = CAPTURE_KPROBE;
+    } else if (strcmp(capture_backend, "tracepoint") == 0) {
+        capture_mode = CAPTURE_TRACEPOINT;
+    } else {
+        printk(KERN_ERR "process_monitor: Unknown capture_backend '%s'\n", capture_backend);
+        return -EINVAL;
+    }
+    
+    if (capture_mode == CAPTURE_KPROBE)
+        ret = register_kprobe_backend();
+    else
+        ret = register_tracepoint_backend();
+    
+    return ret;
+}
+
+static void unregister_capture_backend(void)
+{
+    if (capture_mode == CAPTURE_KPROBE)
+        unregister_kprobe_backend();
+    else
+        unregister_tracepoint_backend();
+}
+
+/*
+ * Record object, its share of the comm table and an estimate of the
+ * record_xa nodes, which are dense because seq numbers are.
+ */
+static unsigned long store_bytes_per_record(int records)
+{
+    unsigned long bytes;
+    
+    if (records <= 0)
+        return kmem_cache_size(record_cache);
+    
+    bytes = (unsigned long)records * kmem_cache_size(record_cache) +
+            READ_ONCE(comm_entries) * sizeof(struct comm_entry) +
+            DIV_ROUND_UP(records, XA_CHUNK_SIZE) * sizeof(struct xa_node) +
+            READ_ONCE(record_extra_count) * kmem_cache_size(extra_cache);
+    
+    return bytes / records;
+}
+
+static void show_usage_row(struct seq_file *m, const char *comm,
+                           const struct usage_totals *t)
+{
+    seq_printf(m, "%-16.16s %-8llu %-10llu %-10llu %-10llu %-10llu %-12llu %-12llu\n", comm,
+               t->exits, div_u64(t->sum.utime_ns, NSEC_PER_MSEC),
+               div_u64(t->sum.stime_ns, NSEC_PER_MSEC),
+               t->exits ? div64_u64(t->sum.maxrss_kb, t->exits) : 0,
+               t->sum.min_flt + t->sum.maj_flt, t->sum.read_bytes, t->sum.write_bytes);
+}
+
+/*
+ * Totals plus the USAGE_TOP_SHOWN commands with the most CPU time. The
+ * per-command sums are read under RCU without process_lock, so a row may
+ * be a few exits behind the totals.
+ */
+static void show_usage_stats(struct seq_file *m, const struct usage_totals *total)
+{
+    struct {
+        char comm[TASK_COMM_LEN];
+        struct usage_totals totals;
+    } *top;
+    struct comm_usage *cu;
+    struct usage_totals other;
+    unsigned int nr = 0, i, seq;
+    int bkt;
+    
+    seq_printf(m, "\n=== Resource Usage at Exit ===\n");
+    seq_printf(m, "Exits Accounted: %llu\n", total->exits);
+    seq_printf(m, "CPU Time: user %llu ms, system %llu ms\n",
+               div_u64(total->sum.utime_ns, NSEC_PER_MSEC),
+               div_u64(total->sum.stime_ns, NSEC_PER_MSEC));
+    seq_printf(m, "Peak RSS: avg %llu KB\n",
+               total->exits ? div64_u64(total->sum.maxrss_kb, total->exits) : 0);
+    seq_printf(m, "Context Switches: %llu voluntary, %llu involuntary\n",
+               total->sum.nvcsw, total->sum.nivcsw);
+    seq_printf(m, "Page Faults: %llu minor, %llu major\n",
+               total->sum.min_flt, total->sum.maj_flt);
+    seq_printf(m, "Storage I/O: %llu bytes read, %llu bytes written\n",
+               total->sum.read_bytes, total->sum.write_bytes);
+    
+    top = kmalloc_array(USAGE_TOP_SHOWN + 1, sizeof(*top), GFP_KERNEL);
+    if (!top)
+        return;
+    
+    rcu_read_lock();
+    hash_for_each_rcu(usage_hash, bkt, cu, node) {
+        u64 cpu = cu->totals.sum.utime_ns + cu->totals.sum.stime_ns;
+        
+        /* Insertion into the top list, kept sorted by CPU time */
+        for (i = nr; i > 0; i--) {
+            if (top[i - 1].totals.sum.utime_ns + top[i - 1].totals.sum.stime_ns >= cpu)
+                break;
+            top[i] = top[i - 1];
+        }
+        if (i < USAGE_TOP_SHOWN) {
+            memcpy(top[i].comm, cu->comm, TASK_COMM_LEN);
+            top[i].totals = cu->totals;
+            if (nr < USAGE_TOP_SHOWN)
+                nr++;
+        }
+    }
+    rcu_read_unlock();
+    
+    do {
+        seq = read_seqcount_begin(&stats_seq);
+        other = usage_other;
+    } while (read_seqcount_retry(&stats_seq, seq));
+    
+    seq_printf(m, "\n%-16s %-8s %-10s %-10s %-10s %-10s %-12s %-12s\n", "COMMAND", "EXITS",
+               "USER_MS", "SYS_MS", "AVG_RSS_KB", "FAULTS", "READ_BYTES", "WRITE_BYTES");
+    for (i = 0; i < nr; i++)
+        show_usage_row(m, top[i].comm, &top[i].totals);
+    if (other.exits)
+        show_usage_row(m, "(other)", &other);
+    
+    kfree(top);
+}
+
+static int stats_show(struct seq_file *m, void *v)
+{
+    struct monitor_stats snap, base;
+    struct lock_timing timing;
+    unsigned long evicted[2], threads[2];
+    unsigned int seq, cap;
+    int records;
+    
+    /* Snapshot without blocking the drain worker; retry if it raced us */
+    do {
+        seq = read_seqcount_begin(&stats_seq);
+        snap = stats;
+        base = stats_base;
+        timing = writer_timing;
+        records = record_count;
+        cap = record_capacity;
+        evicted[0] = evicted_exited;
+        evicted[1] = evicted_running;
+    } while (read_seqcount_retry(&stats_seq, seq));
+    
+    fold_cpu_stats(&snap, &base);
+    
+    seq_printf(m, "=== Process Monitor Statistics ===\n");
+    seq_printf(m, "Monitoring Status: %s\n", monitoring_enabled ? "ENABLED" : "DISABLED");
+    seq_printf(m, "Total Processes Created: %lu\n", snap.total_processes_created);
+    seq_printf(m, "Total Processes Exited: %lu\n", snap.total_processes_exited);
+    seq_printf(m, "Total Execs: %lu\n", snap.total_execs);
+    if (thread_groups) {
+        thread_counts(&threads[0], &threads[1]);
+        seq_printf(m, "Thread Groups: ON, threads created: %lu, exited: %lu\n",
+                   threads[0], threads[1]);
+    } else {
+        seq_printf(m, "Thread Groups: OFF (every thread is a record)\n");
+    }
+    seq_printf(m, "Current Active Processes: %lu\n", snap.current_processes);
+    seq_printf(m, "Peak Processes: %lu (may lag by up to %u)\n", snap.peak_processes,
+               nr_cpu_ids * LIVE_FOLD_BATCH);
+    seq_printf(m, "Records in Memory: %d/%u\n", records, cap);
+    seq_printf(m, "Evicted Records: %lu exited, %lu running\n", evicted[0], evicted[1]);
+    seq_printf(m, "Record Size: %u bytes, interned commands: %u\n",
+               kmem_cache_size(record_cache), READ_ONCE(comm_entries));
+    seq_printf(m, "Bytes per Record: %lu\n", store_bytes_per_record(records));
+    seq_printf(m, "Indexed Records: %d\n", atomic_read(&pid_index.nelems));
+    seq_printf(m, "Staging Events Dropped: %lu\n", staging_dropped_events());
+    seq_printf(m, "Event Ring: %u slots, consumer %s, overruns: %llu\n",
+               ring_nr_events, atomic_read(&ring_users) ? "attached" : "none",
+               READ_ONCE(ring_overruns));
+    seq_printf(m, "Netlink Stream: %llu messages, %llu events sent, %llu lost\n",
+               READ_ONCE(netlink_messages), READ_ONCE(netlink_next_seq) - READ_ONCE(netlink_lost),
+               READ_ONCE(netlink_lost));
+    seq_printf(m, "Record Allocation Failures: %lu\n", alloc_failures);
+    seq_printf(m, "Per-event Logging: %s (suppressed: %lu)\n",
+               verbose_events ? "ON" : "OFF", total_suppressed);
+    
+    show_rate_stats(m);
+    show_governor_stats(m);
+    show_lifetime_stats(m);
+    show_usage_stats(m, &snap.usage);
+    
+    seq_printf(m, "\n=== Writer Lock Timing ===\n");
+    seq_printf(m, "Batches Applied: %llu\n", timing.batches);
+    seq_printf(m, "Lock Wait: max %llu ns, avg %llu ns\n", timing.max_wait_ns,
+               timing.batches ? div64_u64(timing.total_wait_ns, timing.batches) : 0);
+    seq_printf(m, "Lock Hold: max %llu ns, avg %llu ns\n", timing.max_hold_ns,
+               timing.batches ? div64_u64(timing.total_hold_ns, timing.batches) : 0);
+    
+    return 0;
+}
+
+/*
+ * First record passing the filter with seq >= index, or > index when
+ * after is set. record_xa lookups are RCU-safe. Called under RCU.
+ */
+static struct process_record *next_matching_record(unsigned long index, int after)
+{
+    struct process_record *record;
+    
+    if (after)
+        record = xa_find_after(&record_xa, &index, ULONG_MAX, XA_PRESENT);
+    else
+        record = xa_find(&record_xa, &index, ULONG_MAX, XA_PRESENT);
+    
+    while (record && !process_matches_filter(record))
+        record = xa_find_after(&record_xa, &index, ULONG_MAX, XA_PRESENT);
+    
+    return record;
+}
+
+/*
+ * Records are walked under RCU only and resumed by seq through record_xa,
+ * so the file can be read at any size without holding up the drain
+ * worker.
+ */
+static void *processes_start(struct seq_file *m, loff_t *pos)
+{
+    struct process_iter *iter = m->private;
+    struct process_record *record;
+    
+    rcu_read_lock();
+    
+    if (*pos == 0) {
+        iter->cursor = 0;
+        iter->matched = 0;
+        iter->finished = 0;
+        return SEQ_START_TOKEN;
+    }
+    
+    if (iter->finished)
+        return NULL;
+    
+    record = next_matching_record(iter->cursor, 0);
+    return record ? record : PROCESSES_END_TOKEN;
+}
+
+static void *processes_next(struct seq_file *m, void *v, loff_t *pos)
+{
+    struct process_iter *iter = m->private;
+    struct process_record *record;
+    
+    ++*pos;
+    
+    if (v == PROCESSES_END_TOKEN) {
+        iter->finished = 1;
+        return NULL;
+    }
+    
+    if (v == SEQ_START_TOKEN) {
+        record = next_matching_record(0, 0);
+    } else {
+        iter->matched++;
+        record = next_matching_record(((struct process_record *)v)->seq, 1);
+        /*
+         * Step the cursor past the last row so a restart after a full
+         * buffer resumes at the footer instead of repeating that row.
+         */
+        if (!record)
+            iter->cursor = ((struct process_record *)v)->seq + 1;
+    }
+    
+    if (!record)
+        return PROCESSES_END_TOKEN;
+    
+    iter->cursor = record->seq;
+    return record;
+}
+
+static void processes_stop(struct seq_file *m, void *v)
+{
+    rcu_read_unlock();
+}
+
+static int processes_show(struct seq_file *m, void *v)
+{
+    struct process_iter *iter = m->private;
+    struct process_record *record = v;
+    struct record_extra extra;
+    u32 lifetime_ms;
+    
+    if (v == SEQ_START_TOKEN) {
+        seq_printf(m, "=== Process Records ===\n");
+        seq_printf(m, "%-8s %-8s %-16s %-12s %-8s %-9s %-12s %-8s %-10s %-6s %-8s %-8s\n", 
+                   "PID", "PPID", "COMMAND", "START_MS", "STATUS", "EXIT_CODE", "LIFETIME_MS",
+                   "CPU_MS", "MAXRSS_KB", "EXECS", "THREADS", "PEAK_THR");
+        seq_printf(m, "-----------------------------------------------------------------------------------------------------------------------\n");
+        return 0;
+    }
+    
+    if (v == PROCESSES_END_TOKEN) {
+        seq_printf(m, "\nTotal matching records: %lu\n", iter->matched);
+        return 0;
+    }
+    
+    lifetime_ms = smp_load_acquire(&record->lifetime_ms);
+    read_record_extra(record, &extra);
+    
+    seq_printf(m, "%-8d %-8d %-16s %-12llu %-8s %-9d %-12u %-8u %-10u %-6u %-8u %-8u\n",
+               record->pid, record->ppid, record_comm(record),
+               div_u64(record->start_ns - monitor_start_ns, NSEC_PER_MSEC),
+               lifetime_ms == RECORD_RUNNING ? "RUNNING" : "EXITED",
+               READ_ONCE(record->exit_code),
+               lifetime_ms == RECORD_RUNNING ? 0 : lifetime_ms,
+               extra.cpu_ms, extra.maxrss_kb, extra.execs, extra.threads, extra.peak_threads);
+    
+    return 0;
+}
+
+static const struct seq_operations processes_seq_ops = {
+    .start = processes_start,
+    .next = processes_next,
+    .stop = processes_stop,
+    .show = processes_show,
+};
+
+static int filter_show(struct seq_file *m, void *v)
+{
+    const struct filter_rules *rules;
+    unsigned long accepted, rejected;
+    
+    mutex_lock(&config_mutex);
+    
+    seq_printf(m, "=== Process Filter Configuration ===\n");
+    seq_printf(m, "Filter Enabled: %s\n", filter.enabled ? "YES" : "NO");
+    seq_printf(m, "Target PID: %d (0 = any)\n", filter.target_pid);
+    seq_printf(m, "Target PPID: %d (0 = any)\n", filter.target_ppid);
+    seq_printf(m, "Target Command: %s (empty = any)\n", 
+               strlen(filter.target_comm) ? filter.target_comm : "(any)");
+    seq_printf(m, "Min Lifetime: %d seconds (0 = no limit)\n", filter.min_lifetime);
+    seq_printf(m, "Max Lifetime: %d seconds (0 = no limit)\n", filter.max_lifetime);
+    if (filter.uid_set)
+        seq_printf(m, "Target UID: %u (ingest only)\n", filter.target_uid);
+    else
+        seq_printf(m, "Target UID: any (ingest only)\n");
+    seq_printf(m, "Kernel Threads: %s (ingest only)\n",
+               filter.exclude_kthreads ? "excluded" : "included");
+    
+    rules = rcu_dereference_protected(filter_rules, lockdep_is_held(&config_mutex));
+    seq_printf(m, "Allow Rules: %u pids, %u commands\n",
+               rules ? rules->allow.nr_pids : 0, rules ? rules->allow.nr_comms : 0);
+    seq_printf(m, "Deny Rules: %u pids, %u commands\n",
+               rules ? rules->deny.nr_pids : 0, rules ? rules->deny.nr_comms : 0);
+    
+    ingest_counts(&accepted, &rejected);
+    seq_printf(m, "\n=== Ingest Filter ===\n");
+    seq_printf(m, "Ingest Filtering: %s\n", filter.ingest ? "ON" : "OFF");
+    seq_printf(m, "Events Accepted: %lu\n", accepted);
+    seq_printf(m, "Events Rejected: %lu\n", rejected);
+    
+    seq_printf(m, "\n=== Filter Commands ===\n");
+    seq_printf(m, "enable           - Enable filtering\n");
+    seq_printf(m, "disable          - Disable filtering\n");
+    seq_printf(m, "pid <pid>        - Filter by PID\n");
+    seq_printf(m, "ppid <ppid>      - Filter by parent PID\n");
+    seq_printf(m, "comm <command>   - Filter by command name\n");
+    seq_printf(m, "minlife <sec>    - Minimum lifetime filter\n");
+    seq_printf(m, "maxlife <sec>    - Maximum lifetime filter\n");
+    seq_printf(m, "uid <uid>        - Filter by user ID at capture\n");
+    seq_printf(m, "kthreads <exclude|include> - Drop kernel threads at capture\n");
+    seq_printf(m, "ingest <on|off>  - Apply pid/ppid/comm/uid/kthreads/rules before recording\n");
+    seq_printf(m, "allow pid <list> - Only keep these pids or commands (comma list, a-b ranges)\n");
+    seq_printf(m, "allow comm <list>\n");
+    seq_printf(m, "deny pid <list>  - Always drop these pids or commands\n");
+    seq_printf(m, "deny comm <list>\n");
+    seq_printf(m, "clear <allow|deny|rules> - Drop loaded rules\n");
+    seq_printf(m, "reset            - Reset all filters\n");
+    
+    mutex_unlock(&config_mutex);
+    
+    return 0;
+}
+
+static int control_show(struct seq_file *m, void *v)
+{
+    seq_printf(m, "=== Process Monitor Control ===\n");
+    seq_printf(m, "Monitoring: %s\n", monitoring_enabled ? "ENABLED" : "DISABLED");
+    seq_printf(m, "Records: %d/%u\n", READ_ONCE(record_count), READ_ONCE(record_capacity));
+    
+    seq_printf(m, "\n=== Control Commands ===\n");
+    seq_printf(m, "start            - Start monitoring\n");
+    seq_printf(m, "stop             - Stop monitoring\n");
+    seq_printf(m, "clear            - Clear all records\n");
+    seq_printf(m, "reset_stats      - Reset statistics\n");
+    seq_printf(m, "capacity <n>     - Resize the record store (1-%d)\n", MAX_RECORD_CAPACITY);
+    
+    return 0;
+}
+
+static const char *kprobe_dispatch_name(struct kprobe *kp)
+{
+    if (kp->flags & KPROBE_FLAG_FTRACE)
+        return "ftrace";
+    if (kp->flags & KPROBE_FLAG_OPTIMIZED)
+        return "optimized";
+    return "int3";
+}
+
+static int backend_show(struct seq_file *m, void *v)
+{
+    seq_printf(m, "=== Capture Backend ===\n");
+    seq_printf(m, "Mode: %s\n", capture_backend);
+    if (capture_mode == CAPTURE_KPROBE) {
+        seq_printf(m, "Fork kprobe: %s (%s)\n", kp_do_fork.symbol_name,
+                   kprobe_dispatch_name(&kp_do_fork));
+        seq_printf(m, "Exit kprobe: %s (%s)\n", kp_do_exit.symbol_name,
+                   kprobe_dispatch_name(&kp_do_exit));
+        if (kp_exec_registered)
+            seq_printf(m, "Exec kprobe: %s (%s)\n", kp_exec.symbol_name,
+                       kprobe_dispatch_name(&kp_exec));
+        else
+            seq_printf(m, "Exec kprobe: not registered, execs not tracked\n");
+    }
+    
+    /*
+     * The kprobe trap and tracepoint dispatch happen before any handler
+     * can take a timestamp, so the backends are compared from outside.
+     */
+    seq_printf(m, "\nCompare backends with 05_bench -m <module> -b kprobe,tracepoint;\n"
+                  "selfprof shows the handler cost of the loaded backend\n");
+    return 0;
+}
+
+static int compare_topcomm(const void *a, const void *b)
+{
+    const struct topcomm_counter *x = a, *y = b;
+    
+    if (x->count != y->count)
+        return x->count < y->count ? 1 : -1;
+    return 0;
+}
+
+static int topcomm_show(struct seq_file *m, void *v)
+{
+    struct topcomm_counter *counters;
+    unsigned int seq, nr, i;
+    u64 total;
+    
+    counters = kmalloc_array(TOPCOMM_SLOTS, sizeof(*counters), GFP_KERNEL);
+    if (!counters)
+        return -ENOMEM;
+    
+    do {
+        seq = read_seqcount_begin(&stats_seq);
+        total = topcomm.total;
+        nr = topcomm.nr;
+        memcpy(counters, topcomm.counters, nr * sizeof(*counters));
+    } while (read_seqcount_retry(&stats_seq, seq));
+    
+    sort(counters, nr, sizeof(*counters), compare_topcomm, NULL);
+    
+    seq_printf(m, "=== Top Forking Commands ===\n");
+    seq_printf(m, "Forks Counted: %llu\n", total);
+    seq_printf(m, "Tracked Commands: %u/%d\n", nr, TOPCOMM_SLOTS);
+    seq_printf(m, "Max Overestimate: %llu (any command above this many forks is listed)\n",
+               div_u64(total, TOPCOMM_SLOTS));
+    seq_printf(m, "\n%-5s %-16s %-12s %-12s %-12s\n",
+               "RANK", "COMMAND", "COUNT", "ERROR", "AT_LEAST");
+    
+    for (i = 0; i < nr; i++) {
+        seq_printf(m, "%-5u %-16.16s %-12llu %-12llu %-12llu\n", i + 1, counters[i].comm,
+                   counters[i].count, counters[i].error,
+                   counters[i].count - counters[i].error);
+    }
+    
+    kfree(counters);
+    return 0;
+}
+
+/* Last rate_series_secs samples, oldest first, one line per second */
+static int rates_show(struct seq_file *m, void *v)
+{
+    struct rate_history *h;
+    unsigned long first, sec;
+    
+    h = snapshot_rates();
+    if (!h)
+        return -ENOMEM;
+    
+    first = h->seconds - min_t(unsigned long, READ_ONCE(rate_series_secs), h->seconds);
+    
+    seq_printf(m, "%-8s %-10s %-10s\n", "SECOND", "CREATED", "EXITED");
+    for (sec = first; sec < h->seconds; sec++) {
+        const struct rate_sample *sample = &h->samples[sec % RATE_HISTORY_SECS];
+        
+        seq_printf(m, "%-8lu %-10u %-10u\n", sec + 1, sample->created, sample->exited);
+    }
+    
+    kfree(h);
+    return 0;
+}
+
+static ssize_t rates_write(struct file *file, const char __user *buffer,
+                          size_t count, loff_t *pos)
+{
+    unsigned int secs;
+    int ret;
+    
+    ret = kstrtouint_from_user(buffer, count, 10, &secs);
+    if (ret)
+        return ret;
+    if (secs < 1 || secs > RATE_HISTORY_SECS)
+        return -EINVAL;
+    
+    WRITE_ONCE(rate_series_secs, secs);
+    return count;
+}
+
+/*
+ * Copy up to nr records from seq *cursor on into out, advancing *cursor
+ * past the last one. *end is set once no record follows. Returns the
+ * number copied.
+ */
+static unsigned int snapshot_records(struct pm_record *out, unsigned int nr,
+                                     unsigned long *cursor, int *end)
+{
+    struct process_record *record;
+    unsigned long index = *cursor;
+    unsigned int n = 0;
+    
+    rcu_read_lock();
+    for (record = xa_find(&record_xa, &index, ULONG_MAX, XA_PRESENT);
+         record && n < nr;
+         record = xa_find_after(&record_xa, &index, ULONG_MAX, XA_PRESENT)) {
+        struct pm_record *r = &out[n++];
+        struct record_extra extra;
+        
+        read_record_extra(record, &extra);
+        r->lifetime_ms = smp_load_acquire(&record->lifetime_ms);
+        r->seq = record->seq;
+        r->start_ns = record->start_ns;
+        r->pid = record->pid;
+        r->ppid = record->ppid;
+        r->cpu_ms = extra.cpu_ms;
+        r->maxrss_kb = extra.maxrss_kb;
+        r->exit_code = READ_ONCE(record->exit_code);
+        r->execs = min_t(u32, extra.execs, U16_MAX);
+        strscpy_pad(r->comm, record_comm(record), sizeof(r->comm));
+        *cursor = record->seq + 1;
+    }
+    *end = !record;
+    rcu_read_unlock();
+    
+    return n;
+}
+
+/*
+ * Binary paging through the store for agents that would rather not parse
+ * the processes file. Records are gathered under RCU a chunk at a time
+ * and copied out between chunks, so the drain worker is never held up.
+ */
+static long snapshot_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct pm_snapshot_req req;
+    struct pm_record __user *ubuf;
+    struct pm_record *chunk;
+    unsigned long cursor;
+    unsigned int copied = 0, n;
+    int end = 0;
+    long ret = 0;
+    
+    if (cmd != PM_IOC_SNAPSHOT)
+        return -ENOTTY;
+    
+    if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+        return -EFAULT;
+    if (req.version != PM_SNAPSHOT_VERSION)
+        return -EINVAL;
+    
+    chunk = kmalloc_array(SNAPSHOT_CHUNK, sizeof(*chunk), GFP_KERNEL);
+    if (!chunk)
+        return -ENOMEM;
+    
+    ubuf = u64_to_user_ptr(req.buf);
+    cursor = req.cursor;
+    req.generation = READ_ONCE(record_generation);
+    
+    while (copied < req.max_records && !end) {
+        n = snapshot_records(chunk, min_t(unsigned int, req.max_records - copied, SNAPSHOT_CHUNK),
+                             &cursor, &end);
+        if (copy_to_user(ubuf + copied, chunk, n * sizeof(*chunk))) {
+            ret = -EFAULT;
+            break;
+        }
+        copied += n;
+    }
+    
+    kfree(chunk);
+    if (ret)
+        return ret;
+    
+    req.record_size = sizeof(struct pm_record);
+    req.next_cursor = cursor;
+    req.nr_records = copied;
+    req.flags = end ? PM_SNAPSHOT_END : 0;
+    
+    if (copy_to_user((void __user *)arg, &req, sizeof(req)))
+        return -EFAULT;
+    
+    return 0;
+}
+
+static void fold_selfprof(struct selfprof_hist *sum, int slot)
+{
+    int cpu, i;
+    
+    memset(sum, 0, sizeof(*sum));
+    
+    for_each_possible_cpu(cpu) {
+        struct selfprof_hist *hist = &per_cpu_ptr(selfprof, cpu)->hists[slot];
+        
+        sum->count += hist->count;
+        sum->sum_ns += hist->sum_ns;
+        sum->max_ns = max(sum->max_ns, hist->max_ns);
+        for (i = 0; i < SELFPROF_BUCKETS; i++)
+            sum->buckets[i] += hist->buckets[i];
+    }
+}
+
+static u64 selfprof_percentile(const struct selfprof_hist *hist, unsigned int per10k)
+{
+    u64 rank = div64_u64(hist->count * per10k + 9999, 10000);
+    u64 seen = 0;
+    int i;
+    
+    for (i = 0; i < SELFPROF_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank)
+            return min(lifetime_bucket_value(i), hist->max_ns);
+    }
+    
+    return hist->max_ns;
+}
+
+static int selfprof_show(struct seq_file *m, void *v)
+{
+    static const char * const slot_names[SELFPROF_SLOTS] = {
+        "fork handler", "exit handler", "exec handler", "lock wait", "lock hold"
+    };
+    struct selfprof_hist *hist;
+    int slot, cpu;
+    
+    seq_printf(m, "=== Self Profiling ===\n");
+    seq_printf(m, "Status: %s\n", static_key_enabled(&selfprof_key) ? "ON" : "OFF");
+    seq_printf(m, "Write on, off or reset to this file\n");
+    
+    mutex_lock(&config_mutex);
+    if (!selfprof) {
+        mutex_unlock(&config_mutex);
+        return 0;
+    }
+    
+    hist = kmalloc(sizeof(*hist), GFP_KERNEL);
+    if (!hist) {
+        mutex_unlock(&config_mutex);
+        return -ENOMEM;
+    }
+    
+    seq_printf(m, "\n%-14s %-12s %-10s %-10s %-10s %-10s %-10s\n",
+               "SLOT", "COUNT", "MEAN_NS", "P50_NS", "P99_NS", "P999_NS", "MAX_NS");
+    for (slot = 0; slot < SELFPROF_SLOTS; slot++) {
+        fold_selfprof(hist, slot);
+        seq_printf(m, "%-14s %-12llu %-10llu %-10llu %-10llu %-10llu %-10llu\n",
+                   slot_names[slot], hist->count,
+                   hist->count ? div64_u64(hist->sum_ns, hist->count) : 0,
+                   selfprof_percentile(hist, 5000), selfprof_percentile(hist, 9900),
+                   selfprof_percentile(hist, 9990), hist->max_ns);
+    }
+    
+    seq_printf(m, "\n=== Handler Time per CPU ===\n");
+    seq_printf(m, "%-5s %-12s %-12s %-14s\n", "CPU", "EVENTS", "MEAN_NS", "TOTAL_US");
+    for_each_possible_cpu(cpu) {
+        struct selfprof_cpu *sc = per_cpu_ptr(selfprof, cpu);
+        u64 events = 0, nsecs = 0;
+        
+        for (slot = 0; slot < PROCESS_EVENT_TYPES; slot++) {
+            events += sc->hists[slot].count;
+            nsecs += sc->hists[slot].sum_ns;
+        }
+        if (events)
+            seq_printf(m, "%-5d %-12llu %-12llu %-14llu\n", cpu, events,
+                       div64_u64(nsecs, events), div_u64(nsecs, NSEC_PER_USEC));
+    }
+    
+    mutex_unlock(&config_mutex);
+    kfree(hist);
+    return 0;
+}
+
+static ssize_t selfprof_write(struct file *file, const char __user *buffer,
+                             size_t count, loff_t *pos)
+{
+    char cmd[16];
+    int cpu, ret = 0;
+    
+    if (count >= sizeof(cmd))
+        return -EINVAL;
+    
+    if (copy_from_user(cmd, buffer, count))
+        return -EFAULT;
+    
+    cmd[count] = '\0';
+    strim(cmd);
+    
+    mutex_lock(&config_mutex);
+    
+    if (strcmp(cmd, "on") == 0) {
+        if (!selfprof)
+            selfprof = alloc_percpu(struct selfprof_cpu);
+        if (selfprof)
+            static_branch_enable(&selfprof_key);
+        else
+            ret = -ENOMEM;
+    } else if (strcmp(cmd, "off") == 0) {
+        static_branch_disable(&selfprof_key);
+    } else if (strcmp(cmd, "reset") == 0) {
+        if (selfprof) {
+            for_each_possible_cpu(cpu)
+                memset(per_cpu_ptr(selfprof, cpu), 0, sizeof(struct selfprof_cpu));
+        }
+    } else {
+        ret = -EINVAL;
+    }
+    
+    mutex_unlock(&config_mutex);
+    
+    if (ret == 0)
+        printk(KERN_INFO "process_monitor: Self profiling %s\n", cmd);
+    return ret < 0 ? ret : count;
+}
+
+/* Totals over one subtree of the process tree */
+struct tree_totals {
+    unsigned long processes;
+    unsigned long running;
+    u64 lifetime_ms;            /* exited lifetimes plus age of running members */
+};
+
+struct tree_branch {
+    pid_t pid;
+    char comm[TASK_COMM_LEN];
+    struct tree_totals totals;
+};
+
+struct tree_entry {
+    pid_t pid;
+    pid_t ppid;
+    u32 lifetime_ms;
+    unsigned int depth;
+    char comm[TASK_COMM_LEN];
+};
+
+struct tree_query {
+    struct tree_totals totals;
+    struct tree_totals other;   /* branches past TREE_BRANCHES_MAX */
+    struct tree_branch branches[TREE_BRANCHES_MAX];
+    struct tree_entry entries[TREE_LIST_MAX];
+    struct hlist_node *stack[TREE_DEPTH_MAX];
+    unsigned int nr_branches;
+    unsigned int nr_entries;
+    unsigned int max_depth;
+    int truncated;              /* deeper than TREE_DEPTH_MAX */
+};
+
+/* Called under RCU */
+static void tree_visit(struct tree_query *q, struct process_record *record,
+                       unsigned int depth, struct tree_totals *branch, u64 now)
+{
+    u32 lifetime_ms = smp_load_acquire(&record->lifetime_ms);
+    u64 ms;
     
-    list_add_tail(&record->list, &process_list);
-    hash_add(process_hash, &record->hash, pid);
-    insert_process_rb_tree(record);
-    record_count++;
+    if (lifetime_ms == RECORD_RUNNING)
+        ms = now > record->start_ns ? div_u64(now - record->start_ns, NSEC_PER_MSEC) : 0;
+    else
+        ms = lifetime_ms;
     
-    stats.total_processes_created++;
-    stats.current_processes++;
-    if (stats.current_processes > stats.peak_processes) {
-        stats.peak_processes = stats.current_processes;
+    q->totals.processes++;
+    q->totals.lifetime_ms += ms;
+    if (lifetime_ms == RECORD_RUNNING)
+        q->totals.running++;
+    if (branch) {
+        branch->processes++;
+        branch->lifetime_ms += ms;
+        if (lifetime_ms == RECORD_RUNNING)
+            branch->running++;
     }
+    q->max_depth = max(q->max_depth, depth);
     
-    spin_unlock_irqrestore(&process_lock, flags);
-    
-    if (process_matches_filter(record)) {
-        printk(KERN_INFO "process_monitor: Process created - PID: %d, PPID: %d, COMM: %s\n", 
-               pid, ppid, comm);
+    if (q->nr_entries < TREE_LIST_MAX) {
+        struct tree_entry *e = &q->entries[q->nr_entries++];
+        
+        e->pid = record->pid;
+        e->ppid = record->ppid;
+        e->lifetime_ms = lifetime_ms;
+        e->depth = depth;
+        memcpy(e->comm, record_comm(record), TASK_COMM_LEN);
     }
 }
 
-static void mark_process_exit(pid_t pid, int exit_code)
+/*
+ * Depth-first walk of the subtree under root. The stack holds, per level,
+ * the next sibling still to visit, so the walk costs O(subtree) and never
+ * looks at records outside it. Called under RCU: the drain worker may
+ * link or orphan records meanwhile, but unlinked nodes keep their next
+ * pointer and records are only freed after a grace period, so the walk
+ * sees each member at most once and always terminates.
+ */
+static void tree_walk(struct tree_query *q, struct process_record *root)
 {
+    struct hlist_node **stack = q->stack;
+    struct tree_totals *branch = NULL;
     struct process_record *record;
-    unsigned long flags;
-    unsigned long lifetime;
-    
-    if (!monitoring_enabled)
-        return;
+    struct hlist_node *node;
+    unsigned int depth = 0;
+    u64 now = ktime_get_ns();
     
-    spin_lock_irqsave(&process_lock, flags);
+    tree_visit(q, root, 0, NULL, now);
+    stack[0] = rcu_dereference(hlist_first_rcu(&root->children));
     
-    record = find_process_by_pid(pid);
-    if (record) {
-        record->end_time = jiffies;
-        record->status = 0;
-        record->exit_code = exit_code;
-        
-        lifetime = (record->end_time - record->start_time) / HZ;
-        
-        stats.total_processes_exited++;
-        stats.current_processes--;
-        stats.total_cpu_time += record->cpu_time;
+    for (;;) {
+        node = stack[depth];
+        if (!node) {
+            if (depth == 0)
+                break;
+            depth--;
+            continue;
+        }
+        stack[depth] = rcu_dereference(hlist_next_rcu(node));
+        record = hlist_entry(node, struct process_record, sibling);
         
-        if (stats.total_processes_exited == 1) {
-            stats.longest_lifetime = lifetime;
-            stats.shortest_lifetime = lifetime;
-        } else {
-            if (lifetime > stats.longest_lifetime)
-                stats.longest_lifetime = lifetime;
-            if (lifetime < stats.shortest_lifetime)
-                stats.shortest_lifetime = lifetime;
+        if (depth == 0) {
+            if (q->nr_branches < TREE_BRANCHES_MAX) {
+                struct tree_branch *b = &q->branches[q->nr_branches++];
+                
+                b->pid = record->pid;
+                memcpy(b->comm, record_comm(record), TASK_COMM_LEN);
+                branch = &b->totals;
+            } else {
+                branch = &q->other;
+            }
         }
         
-        if (stats.total_processes_exited > 0) {
-            stats.avg_lifetime = (stats.avg_lifetime * (stats.total_processes_exited - 1) + lifetime) / 
-                               stats.total_processes_exited;
+        tree_visit(q, record, depth + 1, branch, now);
+        
+        node = rcu_dereference(hlist_first_rcu(&record->children));
+        if (node) {
+            if (depth + 1 < TREE_DEPTH_MAX)
+                stack[++depth] = node;
+            else
+                q->truncated = 1;
         }
     }
-    
-    spin_unlock_irqrestore(&process_lock, flags);
-    
-    if (record && process_matches_filter(record)) {
-        printk(KERN_INFO "process_monitor: Process exited - PID: %d, Exit Code: %d, Lifetime: %lu sec\n", 
-               pid, exit_code, lifetime);
-    }
-}
-
-static int pre_handler_fork(struct kprobe *p, struct pt_regs *regs)
-{
-    struct task_struct *task = current;
-    add_process_record(task->pid, task->parent->pid, task->comm);
-    return 0;
 }
 
-static int pre_handler_exit(struct kprobe *p, struct pt_regs *regs)
-{
-    struct task_struct *task = current;
-    mark_process_exit(task->pid, task->exit_code);
-    return 0;
-}
-
-static int stats_show(struct seq_file *m, void *v)
+static int tree_show(struct seq_file *m, void *v)
 {
-    unsigned long flags;
-    
-    spin_lock_irqsave(&process_lock, flags);
+    struct process_record *root;
+    struct tree_query *q;
+    unsigned int i;
+    pid_t pid = READ_ONCE(tree_root);
     
-    seq_printf(m, "=== Process Monitor Statistics ===\n");
-    seq_printf(m, "Monitoring Status: %s\n", monitoring_enabled ? "ENABLED" : "DISABLED");
-    seq_printf(m, "Total Processes Created: %lu\n", stats.total_processes_created);
-    seq_printf(m, "Total Processes Exited: %lu\n", stats.total_processes_exited);
-    seq_printf(m, "Current Active Processes: %lu\n", stats.current_processes);
-    seq_printf(m, "Peak Processes: %lu\n", stats.peak_processes);
-    seq_printf(m, "Records in Memory: %d/%d\n", record_count, MAX_PROCESS_RECORDS);
-    seq_printf(m, "\n=== Performance Statistics ===\n");
-    seq_printf(m, "Total CPU Time: %lu jiffies\n", stats.total_cpu_time);
-    seq_printf(m, "Average Lifetime: %lu seconds\n", stats.avg_lifetime);
-    seq_printf(m, "Longest Lifetime: %lu seconds\n", stats.longest_lifetime);
-    seq_printf(m, "Shortest Lifetime: %lu seconds\n", stats.shortest_lifetime);
-    
-    if (stats.total_processes_exited > 0 && jiffies > 0) {
-        unsigned long uptime_seconds = jiffies / HZ;
-        if (uptime_seconds > 0) {
-            seq_printf(m, "Process Turnover Rate: %lu proc/sec\n", 
-                       stats.total_processes_exited / uptime_seconds);
-        }
+    if (pid <= 0) {
+        seq_printf(m, "No subtree selected\n");
+        seq_printf(m, "Write 'tree <pid>' to select the subtree rooted at pid\n");
+        return 0;
     }
     
-    spin_unlock_irqrestore(&process_lock, flags);
+    q = kvzalloc(sizeof(*q), GFP_KERNEL);
+    if (!q)
+        return -ENOMEM;
     
-    return 0;
-}
-
-static int processes_show(struct seq_file *m, void *v)
-{
-    struct process_record *record;
-    unsigned long flags;
-    int count = 0;
+    /* The newest record with that pid, exited ones stay indexed */
+    rcu_read_lock();
+    root = find_process_by_pid(pid);
+    if (root)
+        tree_walk(q, root);
+    rcu_read_unlock();
     
-    seq_printf(m, "=== Process Records ===\n");
-    seq_printf(m, "%-8s %-8s %-16s %-12s %-12s %-8s %-8s %-12s\n", 
-               "PID", "PPID", "COMMAND", "START_TIME", "END_TIME", "STATUS", "EXIT_CODE", "LIFETIME");
-    seq_printf(m, "--------------------------------------------------------------------------------\n");
+    if (!root) {
+        seq_printf(m, "PID %d is not in the record store\n", pid);
+        kvfree(q);
+        return 0;
+    }
     
-    spin_lock_irqsave(&process_lock, flags);
+    seq_printf(m, "=== Process Subtree ===\n");
+    seq_printf(m, "Root: %d (%s)\n", pid, q->entries[0].comm);
+    seq_printf(m, "Processes: %lu\n", q->totals.processes);
+    seq_printf(m, "Running: %lu\n", q->totals.running);
+    seq_printf(m, "Exited: %lu\n", q->totals.processes - q->totals.running);
+    seq_printf(m, "Total lifetime: %llu ms\n", q->totals.lifetime_ms);
+    seq_printf(m, "Depth: %u%s\n", q->max_depth, q->truncated ? " (truncated)" : "");
     
-    list_for_each_entry(record, &process_list, list) {
-        unsigned long lifetime = 0;
-        
-        if (!process_matches_filter(record))
-            continue;
+    if (q->nr_branches) {
+        seq_printf(m, "\n=== Children ===\n");
+        seq_printf(m, "%-8s %-16s %-10s %-8s %-16s\n",
+                   "PID", "COMMAND", "PROCESSES", "RUNNING", "LIFETIME(ms)");
+        for (i = 0; i < q->nr_branches; i++) {
+            struct tree_branch *b = &q->branches[i];
             
-        if (record->status == 0 && record->end_time > record->start_time) {
-            lifetime = (record->end_time - record->start_time) / HZ;
-        }
-        
-        seq_printf(m, "%-8d %-8d %-16s %-12lu %-12lu %-8s %-8d %-12lu\n",
-                   record->pid, record->ppid, record->comm,
-                   record->start_time, record->end_time,
-                   record->status ? "RUNNING" : "EXITED",
-                   record->exit_code, lifetime);
-        
-        count++;
-        if (count >= 50) {
-            seq_printf(m, "... (showing first 50 matching records)\n");
-            break;
+            seq_printf(m, "%-8d %-16s %-10lu %-8lu %-16llu\n", b->pid, b->comm,
+                       b->totals.processes, b->totals.running, b->totals.lifetime_ms);
         }
+        if (q->other.processes)
+            seq_printf(m, "%-8s %-16s %-10lu %-8lu %-16llu\n", "-", "(other)",
+                       q->other.processes, q->other.running, q->other.lifetime_ms);
     }
     
-    spin_unlock_irqrestore(&process_lock, flags);
-    
-    seq_printf(m, "\nTotal matching records: %d\n", count);
+    seq_printf(m, "\n=== Members ===\n");
+    for (i = 0; i < q->nr_entries; i++) {
+        struct tree_entry *e = &q->entries[i];
+        
+        seq_printf(m, "%*s%d %s %s", min(e->depth, 32U) * 2, "", e->pid, e->comm,
+                   e->lifetime_ms == RECORD_RUNNING ? "RUNNING" : "EXITED");
+        if (e->lifetime_ms != RECORD_RUNNING)
+            seq_printf(m, " %u ms", e->lifetime_ms);
+        seq_printf(m, "\n");
+    }
+    if (q->totals.processes > q->nr_entries)
+        seq_printf(m, "... %lu more\n", q->totals.processes - q->nr_entries);
     
+    kvfree(q);
     return 0;
 }
 
-static int filter_show(struct seq_file *m, void *v)
+static ssize_t tree_write(struct file *file, const char __user *buffer,
+                         size_t count, loff_t *pos)
 {
-    mutex_lock(&config_mutex);
-    
-    seq_printf(m, "=== Process Filter Configuration ===\n");
-    seq_printf(m, "Filter Enabled: %s\n", filter.enabled ? "YES" : "NO");
-    seq_printf(m, "Target PID: %d (0 = any)\n", filter.target_pid);
-    seq_printf(m, "Target PPID: %d (0 = any)\n", filter.target_ppid);
-    seq_printf(m, "Target Command: %s (empty = any)\n", 
-               strlen(filter.target_comm) ? filter.target_comm : "(any)");
-    seq_printf(m, "Min Lifetime: %d seconds (0 = no limit)\n", filter.min_lifetime);
-    seq_printf(m, "Max Lifetime: %d seconds (0 = no limit)\n", filter.max_lifetime);
+    char cmd[32];
+    char *arg;
+    int pid;
     
-    seq_printf(m, "\n=== Filter Commands ===\n");
-    seq_printf(m, "enable           - Enable filtering\n");
-    seq_printf(m, "disable          - Disable filtering\n");
-    seq_printf(m, "pid <pid>        - Filter by PID\n");
-    seq_printf(m, "ppid <ppid>      - Filter by parent PID\n");
-    seq_printf(m, "comm <command>   - Filter by command name\n");
-    seq_printf(m, "minlife <sec>    - Minimum lifetime filter\n");
-    seq_printf(m, "maxlife <sec>    - Maximum lifetime filter\n");
-    seq_printf(m, "reset            - Reset all filters\n");
+    if (count >= sizeof(cmd))
+        return -EINVAL;
     
-    mutex_unlock(&config_mutex);
+    if (copy_from_user(cmd, buffer, count))
+        return -EFAULT;
     
-    return 0;
-}
-
-static int control_show(struct seq_file *m, void *v)
-{
-    seq_printf(m, "=== Process Monitor Control ===\n");
-    seq_printf(m, "Monitoring: %s\n", monitoring_enabled ? "ENABLED" : "DISABLED");
-    seq_printf(m, "Records: %d/%d\n", record_count, MAX_PROCESS_RECORDS);
+    cmd[count] = '\0';
+    arg = strim(cmd);
+    if (strncmp(arg, "tree ", 5) == 0)
+        arg = skip_spaces(arg + 5);
     
-    seq_printf(m, "\n=== Control Commands ===\n");
-    seq_printf(m, "start            - Start monitoring\n");
-    seq_printf(m, "stop             - Stop monitoring\n");
-    seq_printf(m, "clear            - Clear all records\n");
-    seq_printf(m, "reset_stats      - Reset statistics\n");
+    if (kstrtoint(arg, 10, &pid) || pid <= 0)
+        return -EINVAL;
     
-    return 0;
+    WRITE_ONCE(tree_root, pid);
+    return count;
 }
 
 static int stats_open(struct inode *inode, struct file *file)
@@ -385,7 +3783,7 @@ static int stats_open(struct inode *inode, struct file *file)
 
 static int processes_open(struct inode *inode, struct file *file)
 {
-    return single_open(file, processes_show, NULL);
+    return seq_open_private(file, &processes_seq_ops, sizeof(struct process_iter));
 }
 
 static int filter_open(struct inode *inode, struct file *file)
@@ -398,23 +3796,61 @@ static int control_open(struct inode *inode, struct file *file)
     return single_open(file, control_show, NULL);
 }
 
-static ssize_t filter_write(struct file *file, const char __user *buffer,
-                           size_t count, loff_t *pos)
+static int backend_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, backend_show, NULL);
+}
+
+static int tree_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, tree_show, NULL);
+}
+
+static int topcomm_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, topcomm_show, NULL);
+}
+
+static int rates_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, rates_show, NULL);
+}
+
+static int selfprof_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, selfprof_show, NULL);
+}
+
+/* Apply one line written to the filter file. Called with config_mutex held */
+static int apply_filter_command(char *cmd, struct filter_rules **draft)
 {
-    char cmd[128];
     char op[32], value[64];
+    char *rest = cmd, *verb, *kind;
     
-    if (count >= sizeof(cmd))
-        return -EINVAL;
-    
-    if (copy_from_user(cmd, buffer, count))
-        return -EFAULT;
-    
-    cmd[count] = '\0';
-    if (cmd[count-1] == '\n')
-        cmd[count-1] = '\0';
-    
-    mutex_lock(&config_mutex);
+    if (strncmp(cmd, "allow ", 6) == 0 || strncmp(cmd, "deny ", 5) == 0 ||
+        strncmp(cmd, "clear ", 6) == 0) {
+        if (!*draft) {
+            *draft = clone_filter_rules();
+            if (!*draft)
+                return -ENOMEM;
+        }
+        
+        verb = strsep(&rest, " ");
+        if (strcmp(verb, "clear") == 0) {
+            rest = strim(rest);
+            if (strcmp(rest, "allow") == 0 || strcmp(rest, "rules") == 0)
+                rule_set_free(&(*draft)->allow);
+            if (strcmp(rest, "deny") == 0 || strcmp(rest, "rules") == 0)
+                rule_set_free(&(*draft)->deny);
+            return 0;
+        }
+        
+        kind = strsep(&rest, " ");
+        if (!rest)
+            return -EINVAL;
+        return parse_rule_list(strcmp(verb, "allow") == 0 ? &(*draft)->allow : &(*draft)->deny,
+                               kind, rest);
+    }
     
     if (strcmp(cmd, "enable") == 0) {
         filter.enabled = 1;
@@ -422,6 +3858,10 @@ static ssize_t filter_write(struct file *file, const char __user *buffer,
         filter.enabled = 0;
     } else if (strcmp(cmd, "reset") == 0) {
         memset(&filter, 0, sizeof(filter));
+        free_filter_rules(*draft);
+        *draft = kzalloc(sizeof(**draft), GFP_KERNEL);
+        if (!*draft)
+            return -ENOMEM;
     } else if (sscanf(cmd, "%31s %63s", op, value) == 2) {
         if (strcmp(op, "pid") == 0) {
             filter.target_pid = simple_strtol(value, NULL, 10);
@@ -434,20 +3874,75 @@ static ssize_t filter_write(struct file *file, const char __user *buffer,
             filter.min_lifetime = simple_strtol(value, NULL, 10);
         } else if (strcmp(op, "maxlife") == 0) {
             filter.max_lifetime = simple_strtol(value, NULL, 10);
+        } else if (strcmp(op, "uid") == 0) {
+            filter.uid_set = kstrtouint(value, 10, &filter.target_uid) == 0;
+        } else if (strcmp(op, "kthreads") == 0) {
+            filter.exclude_kthreads = strcmp(value, "exclude") == 0;
+        } else if (strcmp(op, "ingest") == 0) {
+            filter.ingest = strcmp(value, "on") == 0;
+        }
+    }
+    
+    return 0;
+}
+
+/*
+ * Accepts one command per line so large rule sets can be loaded in a
+ * few writes. Rule changes are staged on a copy and published at once.
+ */
+static ssize_t filter_write(struct file *file, const char __user *buffer,
+                           size_t count, loff_t *pos)
+{
+    struct filter_rules *draft = NULL, *old;
+    char *buf, *cursor, *line;
+    int ret = 0;
+    
+    if (count == 0 || count > FILTER_WRITE_MAX)
+        return -EINVAL;
+    
+    buf = memdup_user_nul(buffer, count);
+    if (IS_ERR(buf))
+        return PTR_ERR(buf);
+    
+    mutex_lock(&config_mutex);
+    
+    cursor = buf;
+    while ((line = strsep(&cursor, "\n")) != NULL) {
+        line = strim(line);
+        if (!*line)
+            continue;
+        ret = apply_filter_command(line, &draft);
+        if (ret < 0)
+            break;
+    }
+    
+    if (draft && ret == 0) {
+        if (!filter_has_rules(draft)) {
+            free_filter_rules(draft);
+            draft = NULL;
         }
+        old = rcu_replace_pointer(filter_rules, draft, lockdep_is_held(&config_mutex));
+        if (old)
+            call_rcu(&old->rcu, free_filter_rules_rcu);
+    } else {
+        free_filter_rules(draft);
     }
     
+    publish_ingest_filter();
+    
     mutex_unlock(&config_mutex);
+    kfree(buf);
     
-    return count;
+    return ret < 0 ? ret : count;
 }
 
 static ssize_t control_write(struct file *file, const char __user *buffer,
                             size_t count, loff_t *pos)
 {
     char cmd[64];
-    struct process_record *record, *tmp;
-    unsigned long flags;
+    struct process_record *record;
+    unsigned long index;
+    unsigned int nr;
     
     if (count >= sizeof(cmd))
         return -EINVAL;
@@ -466,31 +3961,109 @@ static ssize_t control_write(struct file *file, const char __user *buffer,
         monitoring_enabled = 0;
         printk(KERN_INFO "process_monitor: Monitoring stopped\n");
     } else if (strcmp(cmd, "clear") == 0) {
-        spin_lock_irqsave(&process_lock, flags);
+        spin_lock(&process_lock);
+        write_seqcount_begin(&stats_seq);
         
-        list_for_each_entry_safe(record, tmp, &process_list, list) {
-            list_del(&record->list);
-            hash_del(&record->hash);
-            remove_process_rb_tree(record);
-            kfree(record);
-        }
-        
-        record_count = 0;
+        xa_for_each(&record_xa, index, record)
+            release_process_record(record);
         
-        spin_unlock_irqrestore(&process_lock, flags);
+        write_seqcount_end(&stats_seq);
+        spin_unlock(&process_lock);
         
         printk(KERN_INFO "process_monitor: All records cleared\n");
     } else if (strcmp(cmd, "reset_stats") == 0) {
-        spin_lock_irqsave(&process_lock, flags);
+        struct monitor_stats zero = {0};
+        
+        spin_lock(&process_lock);
+        write_seqcount_begin(&stats_seq);
+        fold_cpu_stats(&stats_base, &zero);
+        atomic_long_set(&peak_processes, stats_base.current_processes);
         memset(&stats, 0, sizeof(stats));
-        spin_unlock_irqrestore(&process_lock, flags);
+        memset(&writer_timing, 0, sizeof(writer_timing));
+        topcomm_reset();
+        clear_comm_usage();
+        memset(&lifetime_hist, 0, sizeof(lifetime_hist));
+        write_seqcount_end(&stats_seq);
+        spin_unlock(&process_lock);
         
         printk(KERN_INFO "process_monitor: Statistics reset\n");
+    } else if (strncmp(cmd, "capacity ", 9) == 0) {
+        if (kstrtouint(cmd + 9, 10, &nr) || nr < 1 || nr > MAX_RECORD_CAPACITY)
+            return -EINVAL;
+        
+        mutex_lock(&config_mutex);
+        if (set_record_capacity(nr) < 0)
+            printk(KERN_WARNING "process_monitor: Record pool reserve not resized\n");
+        mutex_unlock(&config_mutex);
+        
+        printk(KERN_INFO "process_monitor: Record capacity set to %u\n", nr);
     }
     
     return count;
 }
 
+/* One consumer at a time; opening the device starts the ring afresh */
+static int ring_open(struct inode *inode, struct file *file)
+{
+    if (atomic_cmpxchg(&ring_users, 0, 1) != 0)
+        return -EBUSY;
+    
+    spin_lock(&ring_lock);
+    ring_head = 0;
+    ring_overruns = 0;
+    event_ring->nr_events = ring_nr_events;
+    event_ring->head = 0;
+    event_ring->tail = 0;
+    event_ring->overruns = 0;
+    ring_active = 1;
+    spin_unlock(&ring_lock);
+    
+    return nonseekable_open(inode, file);
+}
+
+static int ring_release(struct inode *inode, struct file *file)
+{
+    spin_lock(&ring_lock);
+    ring_active = 0;
+    spin_unlock(&ring_lock);
+    
+    atomic_set(&ring_users, 0);
+    return 0;
+}
+
+static int ring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    if (vma->vm_pgoff || vma->vm_end - vma->vm_start > ring_size)
+        return -EINVAL;
+    
+    return remap_vmalloc_range(vma, event_ring, 0);
+}
+
+static __poll_t ring_poll(struct file *file, poll_table *wait)
+{
+    poll_wait(file, &ring_wait, wait);
+    
+    if (READ_ONCE(ring_head) != READ_ONCE(event_ring->tail))
+        return EPOLLIN | EPOLLRDNORM;
+    
+    return 0;
+}
+
+static const struct file_operations ring_fops = {
+    .owner = THIS_MODULE,
+    .open = ring_open,
+    .release = ring_release,
+    .mmap = ring_mmap,
+    .poll = ring_poll,
+};
+
+static struct miscdevice ring_device = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = "process_monitor",
+    .fops = &ring_fops,
+    .mode = 0600,                       /* the consumer stores tail */
+};
+
 static const struct proc_ops stats_fops = {
     .proc_open = stats_open,
     .proc_read = seq_read,
@@ -502,7 +4075,7 @@ static const struct proc_ops processes_fops = {
     .proc_open = processes_open,
     .proc_read = seq_read,
     .proc_lseek = seq_lseek,
-    .proc_release = single_release,
+    .proc_release = seq_release_private,
 };
 
 static const struct proc_ops filter_fops = {
@@ -521,6 +4094,52 @@ static const struct proc_ops control_fops = {
     .proc_release = single_release,
 };
 
+static const struct proc_ops backend_fops = {
+    .proc_open = backend_open,
+    .proc_read = seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+};
+
+static const struct proc_ops tree_fops = {
+    .proc_open = tree_open,
+    .proc_read = seq_read,
+    .proc_write = tree_write,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+};
+
+static const struct proc_ops topcomm_fops = {
+    .proc_open = topcomm_open,
+    .proc_read = seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+};
+
+static const struct proc_ops selfprof_fops = {
+    .proc_open = selfprof_open,
+    .proc_read = seq_read,
+    .proc_write = selfprof_write,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+};
+
+static const struct proc_ops snapshot_fops = {
+    .proc_ioctl = snapshot_ioctl,
+#ifdef CONFIG_COMPAT
+    .proc_compat_ioctl = compat_ptr_ioctl,
+#endif
+    .proc_lseek = noop_llseek,
+};
+
+static const struct proc_ops rates_fops = {
+    .proc_open = rates_open,
+    .proc_read = seq_read,
+    .proc_write = rates_write,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+};
+
 static int __init complete_monitor_init(void)
 {
     int ret;
@@ -528,81 +4147,173 @@ static int __init complete_monitor_init(void)
     printk(KERN_INFO "process_monitor: Loading Complete Process Monitor Module\n");
     
     memset(&stats, 0, sizeof(stats));
+    monitor_start_ns = ktime_get_ns();
+    record_capacity = clamp_t(unsigned int, capacity, 1, MAX_RECORD_CAPACITY);
+    topcomm_reset();
+    
+    ret = create_record_pool();
+    if (ret < 0) {
+        printk(KERN_ERR "process_monitor: Failed to create record cache\n");
+        return ret;
+    }
+    
+    ret = rhashtable_init(&pid_index, &pid_index_params);
+    if (ret < 0) {
+        printk(KERN_ERR "process_monitor: Failed to create pid index\n");
+        destroy_record_pool();
+        return ret;
+    }
+    
+    ret = alloc_staging_buffers();
+    if (ret < 0) {
+        printk(KERN_ERR "process_monitor: Failed to allocate staging buffers\n");
+        rhashtable_destroy(&pid_index);
+        destroy_record_pool();
+        return ret;
+    }
+    
+    ret = alloc_event_ring();
+    if (ret < 0) {
+        printk(KERN_ERR "process_monitor: Failed to allocate event ring\n");
+        free_staging_buffers();
+        rhashtable_destroy(&pid_index);
+        destroy_record_pool();
+        return ret;
+    }
     
     proc_dir = proc_mkdir(PROC_DIR_NAME, NULL);
     if (!proc_dir) {
         printk(KERN_ERR "process_monitor: Failed to create proc directory\n");
+        free_event_ring();
+        free_staging_buffers();
+        rhashtable_destroy(&pid_index);
+        destroy_record_pool();
         return -ENOMEM;
     }
     
     proc_stats = proc_create("stats", 0444, proc_dir, &stats_fops);
     proc_processes = proc_create("processes", 0444, proc_dir, &processes_fops);
-    proc_filter = proc_create("filter", 0666, proc_dir, &filter_fops);
-    proc_control = proc_create("control", 0666, proc_dir, &control_fops);
+    proc_filter = proc_create("filter", 0644, proc_dir, &filter_fops);
+    proc_control = proc_create("control", 0644, proc_dir, &control_fops);
+    proc_backend = proc_create("backend", 0444, proc_dir, &backend_fops);
+    proc_tree = proc_create("tree", 0644, proc_dir, &tree_fops);
+    proc_topcomm = proc_create("topcomm", 0444, proc_dir, &topcomm_fops);
+    proc_rates = proc_create("rates", 0644, proc_dir, &rates_fops);
+    proc_snapshot = proc_create("snapshot", 0444, proc_dir, &snapshot_fops);
+    proc_selfprof = proc_create("selfprof", 0600, proc_dir, &selfprof_fops);
     
-    if (!proc_stats || !proc_processes || !proc_filter || !proc_control) {
+    if (!proc_stats || !proc_processes || !proc_filter || !proc_control || !proc_backend ||
+        !proc_tree || !proc_topcomm || !proc_rates || !proc_snapshot || !proc_selfprof) {
         printk(KERN_ERR "process_monitor: Failed to create proc entries\n");
+        ret = -ENOMEM;
         goto cleanup_proc;
     }
     
-    kp_do_fork.symbol_name = "_do_fork";
-    kp_do_fork.pre_handler = pre_handler_fork;
-    ret = register_kprobe(&kp_do_fork);
+    ret = misc_register(&ring_device);
     if (ret < 0) {
-        kp_do_fork.symbol_name = "kernel_clone";
-        ret = register_kprobe(&kp_do_fork);
-        if (ret < 0) {
-            printk(KERN_ERR "process_monitor: Failed to register fork kprobe: %d\n", ret);
-            goto cleanup_proc;
-        }
+        printk(KERN_ERR "process_monitor: Failed to register %s\n", PM_DEVICE_PATH);
+        goto cleanup_proc;
     }
     
-    kp_do_exit.symbol_name = "do_exit";
-    kp_do_exit.pre_handler = pre_handler_exit;
-    ret = register_kprobe(&kp_do_exit);
+    ret = genl_register_family(&pm_genl_family);
     if (ret < 0) {
-        printk(KERN_ERR "process_monitor: Failed to register exit kprobe: %d\n", ret);
-        unregister_kprobe(&kp_do_fork);
-        goto cleanup_proc;
+        printk(KERN_ERR "process_monitor: Failed to register netlink family: %d\n", ret);
+        goto cleanup_device;
     }
     
+    ret = register_capture_backend();
+    if (ret < 0)
+        goto cleanup_family;
+    
+    ratelimit_set_flags(&event_ratelimit, RATELIMIT_MSG_ON_RELEASE);
+    summary.start = jiffies;
+    queue_delayed_work(system_wq, &drain_work, msecs_to_jiffies(STAGING_DRAIN_INTERVAL_MS));
+    start_rate_timer();
+    
     printk(KERN_INFO "process_monitor: Module loaded successfully\n");
     printk(KERN_INFO "process_monitor: Proc directory: /proc/%s/\n", PROC_DIR_NAME);
-    printk(KERN_INFO "process_monitor: Available interfaces: stats, processes, filter, control\n");
+    printk(KERN_INFO "process_monitor: Capture backend: %s\n", capture_backend);
+    if (thread_groups)
+        printk(KERN_INFO "process_monitor: Thread-group mode: recording leaders only\n");
+    printk(KERN_INFO "process_monitor: Available interfaces: stats, processes, filter, control, backend, tree, topcomm, rates, snapshot, selfprof\n");
+    printk(KERN_INFO "process_monitor: Event ring: %s (%u slots)\n", PM_DEVICE_PATH, ring_nr_events);
+    printk(KERN_INFO "process_monitor: Netlink stream: family %s, group %s\n", PM_GENL_NAME, PM_GENL_MCGRP);
     
     return 0;
 
+cleanup_family:
+    genl_unregister_family(&pm_genl_family);
+cleanup_device:
+    misc_deregister(&ring_device);
 cleanup_proc:
+    if (proc_selfprof) proc_remove(proc_selfprof);
+    if (proc_snapshot) proc_remove(proc_snapshot);
+    if (proc_rates) proc_remove(proc_rates);
+    if (proc_topcomm) proc_remove(proc_topcomm);
+    if (proc_tree) proc_remove(proc_tree);
+    if (proc_backend) proc_remove(proc_backend);
     if (proc_control) proc_remove(proc_control);
     if (proc_filter) proc_remove(proc_filter);
     if (proc_processes) proc_remove(proc_processes);
     if (proc_stats) proc_remove(proc_stats);
     if (proc_dir) proc_remove(proc_dir);
-    return -ENOMEM;
+    free_event_ring();
+    free_staging_buffers();
+    rhashtable_destroy(&pid_index);
+    destroy_record_pool();
+    return ret;
 }
 
 static void __exit complete_monitor_exit(void)
 {
-    struct process_record *record, *tmp;
+    struct process_record *record;
+    struct monitor_stats final = {0};
+    unsigned long index;
     
     printk(KERN_INFO "process_monitor: Unloading Complete Process Monitor Module\n");
     
-    unregister_kprobe(&kp_do_fork);
-    unregister_kprobe(&kp_do_exit);
+    unregister_capture_backend();
+    
+    hrtimer_cancel(&rate_timer);
+    cancel_delayed_work_sync(&drain_work);
+    free_staging_buffers();
     
+    genl_unregister_family(&pm_genl_family);
+    misc_deregister(&ring_device);
+    free_event_ring();
+    
+    proc_remove(proc_selfprof);
+    proc_remove(proc_snapshot);
+    proc_remove(proc_rates);
+    proc_remove(proc_topcomm);
+    proc_remove(proc_tree);
+    proc_remove(proc_backend);
     proc_remove(proc_control);
     proc_remove(proc_filter);
     proc_remove(proc_processes);
     proc_remove(proc_stats);
     proc_remove(proc_dir);
     
-    list_for_each_entry_safe(record, tmp, &process_list, list) {
-        list_del(&record->list);
-        kfree(record);
-    }
+    xa_for_each(&record_xa, index, record)
+        mempool_free(record, record_pool);
+    xa_destroy(&record_xa);
+    
+    /* Wait for records released by eviction or "clear" */
+    rcu_barrier();
+    free_record_extras();
+    free_comm_table();
+    clear_comm_usage();
+    kfree(rcu_dereference_protected(ingest_filter, 1));
+    free_filter_rules(rcu_dereference_protected(filter_rules, 1));
+    
+    rhashtable_destroy(&pid_index);
+    destroy_record_pool();
+    static_branch_disable(&selfprof_key);
+    free_percpu(selfprof);
     
+    fold_cpu_stats(&final, &stats_base);
     printk(KERN_INFO "process_monitor: Final statistics - Created: %lu, Exited: %lu\n",
-           stats.total_processes_created, stats.total_processes_exited);
+           final.total_processes_created, final.total_processes_exited);
     printk(KERN_INFO "process_monitor: Module unloaded successfully\n");
 }
 
@@ -5,6 +5,13 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <pthread.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+
+#include "process_monitor_uapi.h"
 
 #define PROC_BASE "/proc/process_monitor_complete"
 #define MAX_PROCESSES 10
@@ -247,10 +254,133 @@ void performance_test() {
     printf("2. Performance results:\n");
     printf("Created 100 processes in %.3f seconds\n", elapsed);
     printf("Average time per process: %.3f ms\n", (elapsed * 1000) / 100);
+    printf("(single run, not comparable across loads; use 05_bench for module overhead)\n");
     
     read_interface("stats");
 }
 
+void event_ring_test() {
+    printf("=== Event Ring Test (%s) ===\n", PM_DEVICE_PATH);
+    
+    int fd = open(PM_DEVICE_PATH, O_RDWR);
+    if (fd < 0) {
+        perror("open " PM_DEVICE_PATH " (needs root)");
+        return;
+    }
+    
+    struct pm_ring_header *hdr = mmap(NULL, sizeof(*hdr), PROT_READ, MAP_SHARED, fd, 0);
+    if (hdr == MAP_FAILED) {
+        perror("mmap header");
+        close(fd);
+        return;
+    }
+    size_t size = hdr->data_offset + (size_t)hdr->nr_events * hdr->event_size;
+    munmap(hdr, sizeof(*hdr));
+    
+    hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (hdr == MAP_FAILED) {
+        perror("mmap ring");
+        close(fd);
+        return;
+    }
+    struct pm_event *slots = (struct pm_event *)((char *)hdr + hdr->data_offset);
+    printf("Ring: %u slots of %u bytes\n", hdr->nr_events, hdr->event_size);
+    
+    printf("1. Creating test processes:\n");
+    for (int i = 0; i < 5; i++) {
+        if (fork() == 0) {
+            exit(0);
+        }
+    }
+    for (int i = 0; i < 5; i++) {
+        wait(NULL);
+    }
+    
+    printf("2. Reading events for 2 seconds:\n");
+    static const char *names[] = { "FORK", "EXIT", "EXEC" };
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    unsigned long seen = 0;
+    time_t deadline = time(NULL) + 2;
+    
+    while (time(NULL) < deadline) {
+        if (poll(&pfd, 1, 500) <= 0)
+            continue;
+        
+        __u64 head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+        __u64 tail = hdr->tail;
+        
+        for (; tail != head; tail++) {
+            struct pm_event *e = &slots[tail & (hdr->nr_events - 1)];
+            if (seen++ < 20) {
+                printf("%-4s pid %-7d ppid %-7d exit %-4d %-16s",
+                       e->type <= PM_EVENT_EXEC ? names[e->type] : "?",
+                       e->pid, e->ppid, e->exit_code, e->comm);
+                if (e->type == PM_EVENT_EXIT) {
+                    printf(" cpu %lluus rss %lluKB",
+                           (unsigned long long)(e->usage.utime_ns + e->usage.stime_ns) / 1000,
+                           (unsigned long long)e->usage.maxrss_kb);
+                }
+                printf("\n");
+            }
+        }
+        
+        __atomic_store_n(&hdr->tail, tail, __ATOMIC_RELEASE);
+    }
+    
+    printf("3. Results: %lu events read, %llu overruns\n",
+           seen, (unsigned long long)hdr->overruns);
+    
+    munmap(hdr, size);
+    close(fd);
+}
+
+void snapshot_test() {
+    printf("=== Snapshot Test (%s) ===\n", PM_SNAPSHOT_PATH);
+    
+    int fd = open(PM_SNAPSHOT_PATH, O_RDONLY);
+    if (fd < 0) {
+        perror("open " PM_SNAPSHOT_PATH);
+        return;
+    }
+    
+    struct pm_record recs[256];
+    struct pm_snapshot_req req = {
+        .version = PM_SNAPSHOT_VERSION,
+        .buf = (__u64)(unsigned long)recs,
+        .max_records = 256,
+    };
+    unsigned long total = 0, running = 0, pages = 0;
+    __u64 first_generation = 0;
+    
+    do {
+        if (ioctl(fd, PM_IOC_SNAPSHOT, &req) < 0) {
+            perror("PM_IOC_SNAPSHOT");
+            break;
+        }
+        if (pages++ == 0)
+            first_generation = req.generation;
+        
+        for (__u32 i = 0; i < req.nr_records; i++) {
+            if (recs[i].lifetime_ms == PM_RECORD_RUNNING)
+                running++;
+            if (total + i < 10) {
+                printf("%-8d %-8d %-16s %-8s execs %u\n", recs[i].pid, recs[i].ppid, recs[i].comm,
+                       recs[i].lifetime_ms == PM_RECORD_RUNNING ? "RUNNING" : "EXITED",
+                       recs[i].execs);
+            }
+        }
+        total += req.nr_records;
+        req.cursor = req.next_cursor;
+    } while (!(req.flags & PM_SNAPSHOT_END));
+    
+    printf("Records: %lu (%lu running) in %lu pages of %u-byte records\n",
+           total, running, pages, req.record_size);
+    printf("Store %s while paging\n",
+           req.generation == first_generation ? "did not change" : "changed");
+    
+    close(fd);
+}
+
 int main(int argc, char *argv[]) {
     printf("=== Complete Process Monitor Test Program ===\n");
     printf("This program comprehensively tests the complete monitoring system\n\n");
@@ -292,8 +422,10 @@ int main(int argc, char *argv[]) {
         printf("7. Performance test\n");
         printf("8. Read specific interface\n");
         printf("9. Send custom command\n");
-        printf("10. Exit\n");
-        printf("Enter your choice (1-10): ");
+        printf("10. Read events from %s\n", PM_DEVICE_PATH);
+        printf("11. Snapshot records via %s\n", PM_SNAPSHOT_PATH);
+        printf("12. Exit\n");
+        printf("Enter your choice (1-12): ");
         
         if (scanf("%d", &choice) != 1) {
             printf("Invalid input. Please enter a number.\n");
@@ -354,11 +486,19 @@ int main(int argc, char *argv[]) {
             }
             
             case 10:
+                event_ring_test();
+                break;
+                
+            case 11:
+                snapshot_test();
+                break;
+                
+            case 12:
                 printf("Exiting...\n");
                 return 0;
                 
             default:
-                printf("Invalid choice. Please select 1-10.\n");
+                printf("Invalid choice. Please select 1-12.\n");
                 break;
         }
     }
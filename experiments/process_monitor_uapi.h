@@ -0,0 +1,142 @@
+/*
+ * Shared definitions for the /dev/process_monitor event ring and the
+ * generic netlink event stream exported by 05_complete_monitor. Included
+ * by the module and by userspace consumers.
+ */
+#ifndef PROCESS_MONITOR_UAPI_H
+#define PROCESS_MONITOR_UAPI_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define PM_DEVICE_PATH "/dev/process_monitor"
+#define PM_RING_VERSION 2
+#define PM_SNAPSHOT_PATH "/proc/process_monitor_complete/snapshot"
+#define PM_SNAPSHOT_VERSION 1
+
+enum pm_event_type {
+    PM_EVENT_FORK = 0,
+    PM_EVENT_EXIT = 1,
+    PM_EVENT_EXEC = 2,
+};
+
+/* Resource usage of the task as it exits; all zero for other events */
+struct pm_usage {
+    __u64 utime_ns;
+    __u64 stime_ns;
+    __u64 maxrss_kb;        /* peak RSS of the process */
+    __u64 nvcsw;            /* voluntary context switches */
+    __u64 nivcsw;           /* involuntary context switches */
+    __u64 min_flt;
+    __u64 maj_flt;
+    __u64 read_bytes;       /* storage I/O, 0 without CONFIG_TASK_IO_ACCOUNTING */
+    __u64 write_bytes;
+};
+
+/* One fixed-size slot of the ring */
+struct pm_event {
+    __u64 timestamp_ns;     /* ktime_get_ns() at capture */
+    __s32 pid;
+    __s32 ppid;
+    __s32 exit_code;
+    __u32 type;             /* enum pm_event_type */
+    char comm[16];
+    struct pm_usage usage;  /* since version 2 */
+};
+
+/*
+ * The mapping starts with this header page, followed by nr_events slots
+ * at data_offset. The kernel advances head, the consumer advances tail;
+ * both are free-running and index the ring modulo nr_events. When the
+ * ring is full new events are dropped and counted in overruns.
+ *
+ * Consumer loop: read head with acquire semantics, process slots
+ * [tail, head), then store tail with release semantics. The kernel
+ * never reads the other fields back, and clamps tail to
+ * [head - nr_events, head]. The device must be opened O_RDWR to map
+ * the header writable.
+ */
+struct pm_ring_header {
+    __u32 version;
+    __u32 event_size;
+    __u32 nr_events;        /* power of two */
+    __u32 data_offset;
+    __u64 overruns;
+    __u64 pad0[5];
+    __u64 head;             /* written by the kernel, own cache line */
+    __u64 pad1[7];
+    __u64 tail;             /* written by the consumer, own cache line */
+    __u64 pad2[7];
+};
+
+/* lifetime_ms of a record whose process has not exited */
+#define PM_RECORD_RUNNING 0xffffffffu
+
+/* One record of the store as returned by PM_IOC_SNAPSHOT */
+struct pm_record {
+    __u64 seq;              /* position in the store, increases with every fork */
+    __u64 start_ns;         /* ktime_get_ns() at fork */
+    __s32 pid;
+    __s32 ppid;
+    __u32 lifetime_ms;      /* PM_RECORD_RUNNING until the exit is seen */
+    __u32 cpu_ms;           /* utime + stime at exit */
+    __u32 maxrss_kb;        /* peak RSS at exit */
+    __u16 exit_code;
+    __u16 execs;            /* execs seen, saturates at 65535; was reserved */
+    char comm[16];          /* name after the last exec seen */
+};
+
+#define PM_SNAPSHOT_END 0x1     /* no records past next_cursor */
+
+/*
+ * Page through the record store. Set version, buf and max_records, and
+ * cursor to 0 for the first call; pass next_cursor back as cursor to
+ * continue. generation changes whenever a record is added, exits or is
+ * evicted, so equal generations across pages mean a consistent view.
+ */
+struct pm_snapshot_req {
+    __u32 version;          /* in: PM_SNAPSHOT_VERSION */
+    __u32 record_size;      /* out: sizeof(struct pm_record) */
+    __u64 cursor;           /* in: seq to start from */
+    __u64 next_cursor;      /* out */
+    __u64 generation;       /* out: store generation before the copy */
+    __u64 buf;              /* in: struct pm_record array */
+    __u32 max_records;      /* in */
+    __u32 nr_records;       /* out */
+    __u32 flags;            /* out: PM_SNAPSHOT_* */
+    __u32 reserved;
+};
+
+#define PM_IOC_MAGIC 'P'
+#define PM_IOC_SNAPSHOT _IOWR(PM_IOC_MAGIC, 1, struct pm_snapshot_req)
+
+/*
+ * Generic netlink family PM_GENL_NAME multicasts PM_CMD_EVENTS messages
+ * to group PM_GENL_MCGRP. Each message carries PM_ATTR_COUNT struct
+ * pm_event back to back in PM_ATTR_EVENTS, numbered consecutively from
+ * PM_ATTR_SEQ. If a message's PM_ATTR_SEQ is past the previous message's
+ * PM_ATTR_SEQ + PM_ATTR_COUNT, the difference was lost: PM_ATTR_LOST
+ * counts the events the module could not send, and anything beyond that
+ * overflowed the listener's socket (recv() also fails with ENOBUFS).
+ */
+#define PM_GENL_NAME "process_monitor"
+#define PM_GENL_VERSION 1
+#define PM_GENL_MCGRP "events"
+
+enum pm_genl_cmd {
+    PM_CMD_UNSPEC,
+    PM_CMD_EVENTS,
+};
+
+enum pm_genl_attr {
+    PM_ATTR_UNSPEC,
+    PM_ATTR_PAD,
+    PM_ATTR_SEQ,            /* __u64, sequence number of the first event */
+    PM_ATTR_COUNT,          /* __u32 */
+    PM_ATTR_LOST,           /* __u64, events dropped by the module so far */
+    PM_ATTR_EVENTS,         /* struct pm_event[PM_ATTR_COUNT] */
+    __PM_ATTR_MAX,
+};
+#define PM_ATTR_MAX (__PM_ATTR_MAX - 1)
+
+#endif /* PROCESS_MONITOR_UAPI_H */
@@ -6,11 +6,20 @@
 #include <linux/sched.h>
 #include <linux/sched/signal.h>
 #include <linux/kprobes.h>
+#include <linux/tracepoint.h>
+#include <linux/binfmts.h>
 #include <linux/slab.h>
+#include <linux/mempool.h>
 #include <linux/spinlock.h>
 #include <linux/time.h>
 #include <linux/uaccess.h>
 #include <linux/string.h>
+#include <linux/rhashtable.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/sort.h>
+#include <linux/ratelimit.h>
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Student");
@@ -19,6 +28,13 @@ MODULE_VERSION("1.0");
 
 #define PROC_NAME "process_monitor"
 #define MAX_PROCESS_RECORDS 1000
+#define RECORD_CACHE_NAME "process_monitor_record"
+#define STAGING_BUFFER_SIZE 1024        /* events per CPU, power of two */
+#define STAGING_KICK_THRESHOLD 512      /* wake the drain worker early at this fill level */
+#define STAGING_DRAIN_INTERVAL_MS 100
+#define DRAIN_BATCH_MAX 4096
+#define SUMMARY_TOP_SLOTS 32            /* distinct commands tracked per summary interval */
+#define SUMMARY_TOP_SHOWN 5
 
 struct process_record {
     pid_t pid;
@@ -28,54 +44,229 @@ struct process_record {
     unsigned long end_time;
     int status;
     struct list_head list;
+    struct rhash_head pid_node;
 };
 
 struct monitor_stats {
     unsigned long total_processes_created;
     unsigned long total_processes_exited;
+    unsigned long total_execs;
     unsigned long current_processes;
     unsigned long peak_processes;
 };
 
+enum process_event_type {
+    PROCESS_EVENT_FORK,
+    PROCESS_EVENT_EXIT,
+    PROCESS_EVENT_EXEC,
+    PROCESS_EVENT_TYPES,
+};
+
+enum capture_mode {
+    CAPTURE_KPROBE,
+    CAPTURE_TRACEPOINT,
+};
+
+/* Fixed-size event captured by the probe handlers into a per-CPU buffer */
+struct process_event {
+    u64 timestamp;
+    unsigned long jiffies;
+    pid_t pid;
+    pid_t ppid;
+    int type;
+    char comm[TASK_COMM_LEN];
+};
+
+/*
+ * Single-producer/single-consumer ring: head is advanced only by the
+ * handlers running on the owning CPU, tail only by the drain worker.
+ */
+struct staging_buffer {
+    unsigned int head;
+    unsigned int tail;
+    unsigned long dropped;
+    struct process_event *events;
+};
+
+struct capture_tracepoint {
+    const char *name;
+    void *probe;
+    struct tracepoint *tp;
+    int registered;
+};
+
+struct comm_count {
+    char comm[TASK_COMM_LEN];
+    unsigned long count;
+};
+
+/* Per-interval event counts, touched only by the drain worker */
+struct event_summary {
+    unsigned long start;
+    unsigned long forks;
+    unsigned long exits;
+    unsigned long execs;
+    unsigned long suppressed;
+    int nr_comms;
+    struct comm_count comms[SUMMARY_TOP_SLOTS];
+};
+
+struct drain_slot {
+    struct process_event event;
+    struct process_record *record;
+};
+
 static struct proc_dir_entry *proc_entry;
 static struct monitor_stats stats;
 static LIST_HEAD(process_list);
+static struct rhashtable pid_index;
 static DEFINE_SPINLOCK(process_lock);
 static int record_count = 0;
+static struct kmem_cache *record_cache;
+static mempool_t *record_pool;
+static unsigned long alloc_failures = 0;
 
 static struct kprobe kp_do_fork;
 static struct kprobe kp_do_exit;
 
-static void add_process_record(pid_t pid, pid_t ppid, const char *comm)
+static char *capture_backend = "kprobe";
+module_param(capture_backend, charp, 0444);
+MODULE_PARM_DESC(capture_backend, "Event source: kprobe or tracepoint (default kprobe)");
+static int capture_mode = CAPTURE_KPROBE;
+
+static bool verbose_events = false;
+module_param(verbose_events, bool, 0644);
+MODULE_PARM_DESC(verbose_events, "Log every fork/exit event, rate limited (default off)");
+static unsigned int summary_interval = 10;
+module_param(summary_interval, uint, 0644);
+MODULE_PARM_DESC(summary_interval, "Seconds between event summaries in the kernel log, 0 disables (default 10)");
+static DEFINE_RATELIMIT_STATE(event_ratelimit, 5 * HZ, 10);
+static struct event_summary summary;
+static unsigned long total_suppressed = 0;
+
+static DEFINE_PER_CPU(struct staging_buffer, staging_buffers);
+static struct drain_slot *drain_slots;
+static unsigned int drain_quota;
+static void drain_staging_buffers(struct work_struct *work);
+static DECLARE_DELAYED_WORK(drain_work, drain_staging_buffers);
+
+/*
+ * Only RUNNING records are indexed by pid. The table grows and shrinks
+ * with the number of live records, keeping exit lookups O(1).
+ */
+static const struct rhashtable_params pid_index_params = {
+    .key_len = sizeof(pid_t),
+    .key_offset = offsetof(struct process_record, pid),
+    .head_offset = offsetof(struct process_record, pid_node),
+    .automatic_shrinking = true,
+};
+
+static struct process_record *find_process_by_pid(pid_t pid)
+{
+    return rhashtable_lookup_fast(&pid_index, &pid, pid_index_params);
+}
+
+/*
+ * Index a new RUNNING record. A still-indexed record with the same pid
+ * (its exit was never seen) is displaced so exits match the newest one.
+ */
+static void index_process_record(struct process_record *record)
+{
+    struct process_record *old;
+    
+    old = find_process_by_pid(record->pid);
+    if (old) {
+        if (rhashtable_replace_fast(&pid_index, &old->pid_node,
+                                    &record->pid_node, pid_index_params) == 0)
+            return;
+        rhashtable_remove_fast(&pid_index, &old->pid_node, pid_index_params);
+    }
+    
+    rhashtable_insert_fast(&pid_index, &record->pid_node, pid_index_params);
+}
+
+static void unindex_process_record(struct process_record *record)
+{
+    rhashtable_remove_fast(&pid_index, &record->pid_node, pid_index_params);
+}
+
+static void fill_process_event(struct process_event *event, int type,
+                               struct task_struct *task, pid_t ppid)
+{
+    event->timestamp = ktime_get_ns();
+    event->jiffies = jiffies;
+    event->type = type;
+    event->pid = task->pid;
+    event->ppid = ppid;
+    memcpy(event->comm, task->comm, TASK_COMM_LEN);
+    event->comm[TASK_COMM_LEN-1] = '\0';
+}
+
+static void stage_process_event(int type, struct task_struct *task, pid_t ppid)
+{
+    struct staging_buffer *buf = this_cpu_ptr(&staging_buffers);
+    unsigned int head = buf->head;
+    unsigned int tail = smp_load_acquire(&buf->tail);
+    
+    if (head - tail >= STAGING_BUFFER_SIZE) {
+        buf->dropped++;
+        return;
+    }
+    
+    fill_process_event(&buf->events[head & (STAGING_BUFFER_SIZE - 1)], type, task, ppid);
+    
+    smp_store_release(&buf->head, head + 1);
+    
+    if (head - tail + 1 == STAGING_KICK_THRESHOLD)
+        mod_delayed_work(system_wq, &drain_work, 0);
+}
+
+static unsigned long staging_dropped_events(void)
+{
+    unsigned long dropped = 0;
+    int cpu;
+    
+    for_each_possible_cpu(cpu)
+        dropped += per_cpu_ptr(&staging_buffers, cpu)->dropped;
+    
+    return dropped;
+}
+
+static struct process_record *alloc_process_record(const struct process_event *event)
 {
     struct process_record *record;
-    unsigned long flags;
     
-    record = kmalloc(sizeof(struct process_record), GFP_ATOMIC);
+    record = mempool_alloc(record_pool, GFP_NOWAIT | __GFP_NOWARN);
     if (!record) {
-        printk(KERN_WARNING "process_monitor: Failed to allocate memory for process record\n");
-        return;
+        alloc_failures++;
+        return NULL;
     }
     
-    record->pid = pid;
-    record->ppid = ppid;
-    strncpy(record->comm, comm, TASK_COMM_LEN);
-    record->comm[TASK_COMM_LEN-1] = '\0';
-    record->start_time = jiffies;
+    record->pid = event->pid;
+    record->ppid = event->ppid;
+    memcpy(record->comm, event->comm, TASK_COMM_LEN);
+    record->start_time = event->jiffies;
     record->end_time = 0;
     record->status = 1;
     
-    spin_lock_irqsave(&process_lock, flags);
-    
+    return record;
+}
+
+/* Called with process_lock held */
+static void add_process_record(struct process_record *record)
+{
     if (record_count >= MAX_PROCESS_RECORDS) {
         struct process_record *oldest;
         oldest = list_first_entry(&process_list, struct process_record, list);
         list_del(&oldest->list);
-        kfree(oldest);
+        if (oldest->status == 1)
+            unindex_process_record(oldest);
+        mempool_free(oldest, record_pool);
         record_count--;
     }
     
     list_add_tail(&record->list, &process_list);
+    index_process_record(record);
     record_count++;
     
     stats.total_processes_created++;
@@ -83,67 +274,481 @@ static void add_process_record(pid_t pid, pid_t ppid, const char *comm)
     if (stats.current_processes > stats.peak_processes) {
         stats.peak_processes = stats.current_processes;
     }
+}
+
+/* Called with process_lock held */
+static void mark_process_exit(const struct process_event *event)
+{
+    struct process_record *record;
+    
+    record = find_process_by_pid(event->pid);
+    if (record) {
+        unindex_process_record(record);
+        record->end_time = event->jiffies;
+        record->status = 0;
+        stats.total_processes_exited++;
+        stats.current_processes--;
+    }
+}
+
+static void account_summary_event(const struct process_event *event)
+{
+    int i;
+    
+    if (event->type == PROCESS_EVENT_EXIT) {
+        summary.exits++;
+        return;
+    }
     
-    spin_unlock_irqrestore(&process_lock, flags);
+    if (event->type == PROCESS_EVENT_EXEC)
+        summary.execs++;
+    else
+        summary.forks++;
     
-    printk(KERN_INFO "process_monitor: Process created - PID: %d, PPID: %d, COMM: %s\n", 
-           pid, ppid, comm);
+    for (i = 0; i < summary.nr_comms; i++) {
+        if (memcmp(summary.comms[i].comm, event->comm, TASK_COMM_LEN) == 0) {
+            summary.comms[i].count++;
+            return;
+        }
+    }
+    
+    if (summary.nr_comms < SUMMARY_TOP_SLOTS) {
+        memcpy(summary.comms[i].comm, event->comm, TASK_COMM_LEN);
+        summary.comms[i].count = 1;
+        summary.nr_comms++;
+    }
 }
 
-static void mark_process_exit(pid_t pid)
+static int compare_comm_counts(const void *a, const void *b)
 {
-    struct process_record *record;
-    unsigned long flags;
+    const struct comm_count *x = a, *y = b;
+    
+    if (x->count > y->count)
+        return -1;
+    return x->count < y->count;
+}
+
+static void emit_event_summary(void)
+{
+    char top[SUMMARY_TOP_SHOWN * (TASK_COMM_LEN + 24)];
+    unsigned long seconds;
+    int len = 0;
+    int i;
     
-    spin_lock_irqsave(&process_lock, flags);
+    seconds = max_t(unsigned long, (jiffies - summary.start) / HZ, 1);
     
-    list_for_each_entry(record, &process_list, list) {
-        if (record->pid == pid && record->status == 1) {
-            record->end_time = jiffies;
-            record->status = 0;
-            stats.total_processes_exited++;
-            stats.current_processes--;
-            break;
+    if (summary.forks || summary.exits || summary.execs || summary.suppressed) {
+        sort(summary.comms, summary.nr_comms, sizeof(struct comm_count),
+             compare_comm_counts, NULL);
+        
+        top[0] = '\0';
+        for (i = 0; i < summary.nr_comms && i < SUMMARY_TOP_SHOWN; i++) {
+            len += scnprintf(top + len, sizeof(top) - len, "%s%s(%lu)",
+                             i ? " " : "", summary.comms[i].comm, summary.comms[i].count);
+        }
+        
+        printk(KERN_INFO "process_monitor: last %lus - forks: %lu (%lu/s), exits: %lu (%lu/s), "
+               "execs: %lu, suppressed: %lu, top: %s\n",
+               seconds, summary.forks, summary.forks / seconds,
+               summary.exits, summary.exits / seconds, summary.execs,
+               summary.suppressed, len ? top : "-");
+    }
+    
+    memset(&summary, 0, sizeof(summary));
+    summary.start = jiffies;
+}
+
+static void report_staged_event(const struct drain_slot *slot)
+{
+    if (!__ratelimit(&event_ratelimit)) {
+        summary.suppressed++;
+        total_suppressed++;
+        return;
+    }
+    
+    if (slot->event.type == PROCESS_EVENT_FORK) {
+        printk(KERN_INFO "process_monitor: Process created - PID: %d, PPID: %d, COMM: %s\n", 
+               slot->event.pid, slot->event.ppid, slot->event.comm);
+    } else if (slot->event.type == PROCESS_EVENT_EXEC) {
+        printk(KERN_INFO "process_monitor: Process exec - PID: %d, COMM: %s\n", 
+               slot->event.pid, slot->event.comm);
+    } else {
+        printk(KERN_INFO "process_monitor: Process exited - PID: %d\n", slot->event.pid);
+    }
+}
+
+/*
+ * Apply one drained batch to the store. Records for fork events are
+ * allocated up front so that process_lock is taken once per batch.
+ */
+static void apply_staged_events(struct drain_slot *slots, unsigned int nr)
+{
+    struct drain_slot *slot;
+    unsigned int i;
+    
+    for (i = 0; i < nr; i++) {
+        slot = &slots[i];
+        slot->record = NULL;
+        if (slot->event.type == PROCESS_EVENT_FORK)
+            slot->record = alloc_process_record(&slot->event);
+    }
+    
+    spin_lock(&process_lock);
+    
+    for (i = 0; i < nr; i++) {
+        slot = &slots[i];
+        if (slot->event.type == PROCESS_EVENT_FORK) {
+            if (slot->record)
+                add_process_record(slot->record);
+        } else if (slot->event.type == PROCESS_EVENT_EXEC) {
+            stats.total_execs++;
+        } else {
+            mark_process_exit(&slot->event);
+        }
+    }
+    
+    spin_unlock(&process_lock);
+    
+    for (i = 0; i < nr; i++) {
+        slot = &slots[i];
+        account_summary_event(&slot->event);
+        if (verbose_events)
+            report_staged_event(slot);
+    }
+}
+
+static int compare_drain_slots(const void *a, const void *b)
+{
+    const struct drain_slot *x = a, *y = b;
+    
+    if (x->event.timestamp < y->event.timestamp)
+        return -1;
+    return x->event.timestamp > y->event.timestamp;
+}
+
+/*
+ * Pull up to drain_quota events from every CPU, restore global order by
+ * capture timestamp and apply them. Re-queues itself immediately while
+ * any buffer still holds events, otherwise at the regular interval.
+ */
+static void drain_staging_buffers(struct work_struct *work)
+{
+    unsigned int nr = 0;
+    int pending = 0;
+    int cpu;
+    
+    for_each_possible_cpu(cpu) {
+        struct staging_buffer *buf = per_cpu_ptr(&staging_buffers, cpu);
+        unsigned int head = smp_load_acquire(&buf->head);
+        unsigned int tail = buf->tail;
+        unsigned int taken = 0;
+        
+        while (tail != head && taken < drain_quota) {
+            drain_slots[nr++].event = buf->events[tail & (STAGING_BUFFER_SIZE - 1)];
+            tail++;
+            taken++;
         }
+        
+        smp_store_release(&buf->tail, tail);
+        if (tail != head)
+            pending = 1;
+    }
+    
+    if (nr) {
+        sort(drain_slots, nr, sizeof(struct drain_slot), compare_drain_slots, NULL);
+        apply_staged_events(drain_slots, nr);
+    }
+    
+    if (summary_interval &&
+        time_after_eq(jiffies, summary.start + (unsigned long)summary_interval * HZ))
+        emit_event_summary();
+    
+    queue_delayed_work(system_wq, &drain_work,
+                       pending ? 0 : msecs_to_jiffies(STAGING_DRAIN_INTERVAL_MS));
+}
+
+static void free_staging_buffers(void)
+{
+    int cpu;
+    
+    for_each_possible_cpu(cpu) {
+        struct staging_buffer *buf = per_cpu_ptr(&staging_buffers, cpu);
+        kvfree(buf->events);
+        buf->events = NULL;
+    }
+    
+    kvfree(drain_slots);
+    drain_slots = NULL;
+}
+
+/*
+ * Records come from a dedicated slab cache backed by a mempool holding
+ * MAX_PROCESS_RECORDS preallocated objects, so the store can always be
+ * refilled up to its cap without touching the general allocator.
+ */
+static int create_record_pool(void)
+{
+    record_cache = kmem_cache_create(RECORD_CACHE_NAME, sizeof(struct process_record),
+                                     0, SLAB_HWCACHE_ALIGN, NULL);
+    if (!record_cache)
+        return -ENOMEM;
+    
+    record_pool = mempool_create_slab_pool(MAX_PROCESS_RECORDS, record_cache);
+    if (!record_pool) {
+        kmem_cache_destroy(record_cache);
+        record_cache = NULL;
+        return -ENOMEM;
+    }
+    
+    return 0;
+}
+
+static void destroy_record_pool(void)
+{
+    mempool_destroy(record_pool);
+    kmem_cache_destroy(record_cache);
+    record_pool = NULL;
+    record_cache = NULL;
+}
+
+static int alloc_staging_buffers(void)
+{
+    int cpu;
+    
+    for_each_possible_cpu(cpu) {
+        struct staging_buffer *buf = per_cpu_ptr(&staging_buffers, cpu);
+        buf->events = kvmalloc_node(STAGING_BUFFER_SIZE * sizeof(struct process_event),
+                                    GFP_KERNEL, cpu_to_node(cpu));
+        if (!buf->events)
+            goto fail;
+        buf->head = 0;
+        buf->tail = 0;
+        buf->dropped = 0;
     }
     
-    spin_unlock_irqrestore(&process_lock, flags);
+    drain_quota = max_t(unsigned int, DRAIN_BATCH_MAX / num_possible_cpus(), 1);
+    drain_slots = kvmalloc_array(drain_quota * num_possible_cpus(),
+                                 sizeof(struct drain_slot), GFP_KERNEL);
+    if (!drain_slots)
+        goto fail;
     
-    printk(KERN_INFO "process_monitor: Process exited - PID: %d\n", pid);
+    return 0;
+
+fail:
+    free_staging_buffers();
+    return -ENOMEM;
 }
 
+/*
+ * kprobe backend. The probe fires in the parent before the child exists,
+ * so the record carries the caller's pid.
+ */
 static int pre_handler_fork(struct kprobe *p, struct pt_regs *regs)
 {
     struct task_struct *task = current;
-    add_process_record(task->pid, task->parent->pid, task->comm);
+    
+    stage_process_event(PROCESS_EVENT_FORK, task, task->parent->pid);
     return 0;
 }
 
 static int pre_handler_exit(struct kprobe *p, struct pt_regs *regs)
 {
     struct task_struct *task = current;
-    mark_process_exit(task->pid);
+    
+    stage_process_event(PROCESS_EVENT_EXIT, task, task->parent->pid);
+    return 0;
+}
+
+/*
+ * Tracepoint backend. sched_process_fork runs once the child exists, so
+ * the record gets the child's pid with the real parent as ppid.
+ */
+static void probe_sched_process_fork(void *data, struct task_struct *parent,
+                                     struct task_struct *child)
+{
+    stage_process_event(PROCESS_EVENT_FORK, child, parent->pid);
+}
+
+static void probe_sched_process_exec(void *data, struct task_struct *p,
+                                     pid_t old_pid, struct linux_binprm *bprm)
+{
+    stage_process_event(PROCESS_EVENT_EXEC, p, p->real_parent->pid);
+}
+
+static void probe_sched_process_exit(void *data, struct task_struct *p)
+{
+    stage_process_event(PROCESS_EVENT_EXIT, p, p->real_parent->pid);
+}
+
+static struct capture_tracepoint capture_tracepoints[] = {
+    { .name = "sched_process_fork", .probe = probe_sched_process_fork },
+    { .name = "sched_process_exec", .probe = probe_sched_process_exec },
+    { .name = "sched_process_exit", .probe = probe_sched_process_exit },
+};
+
+static int register_kprobe_backend(void)
+{
+    int ret;
+    
+    kp_do_fork.symbol_name = "_do_fork";
+    kp_do_fork.pre_handler = pre_handler_fork;
+    ret = register_kprobe(&kp_do_fork);
+    if (ret < 0) {
+        kp_do_fork.symbol_name = "kernel_clone";
+        ret = register_kprobe(&kp_do_fork);
+        if (ret < 0) {
+            printk(KERN_ERR "process_monitor: Failed to register fork kprobe: %d\n", ret);
+            return ret;
+        }
+    }
+    
+    kp_do_exit.symbol_name = "do_exit";
+    kp_do_exit.pre_handler = pre_handler_exit;
+    ret = register_kprobe(&kp_do_exit);
+    if (ret < 0) {
+        printk(KERN_ERR "process_monitor: Failed to register exit kprobe: %d\n", ret);
+        unregister_kprobe(&kp_do_fork);
+        return ret;
+    }
+    
+    return 0;
+}
+
+static void unregister_kprobe_backend(void)
+{
+    unregister_kprobe(&kp_do_fork);
+    unregister_kprobe(&kp_do_exit);
+}
+
+/* The sched tracepoints are not exported to modules; look them up by name */
+static void lookup_capture_tracepoint(struct tracepoint *tp, void *priv)
+{
+    int i;
+    
+    for (i = 0; i < ARRAY_SIZE(capture_tracepoints); i++) {
+        if (strcmp(tp->name, capture_tracepoints[i].name) == 0)
+            capture_tracepoints[i].tp = tp;
+    }
+}
+
+static void unregister_tracepoint_backend(void)
+{
+    int i;
+    
+    for (i = 0; i < ARRAY_SIZE(capture_tracepoints); i++) {
+        if (capture_tracepoints[i].registered) {
+            tracepoint_probe_unregister(capture_tracepoints[i].tp,
+                                        capture_tracepoints[i].probe, NULL);
+            capture_tracepoints[i].registered = 0;
+        }
+    }
+    
+    tracepoint_synchronize_unregister();
+}
+
+static int register_tracepoint_backend(void)
+{
+    int ret;
+    int i;
+    
+    for_each_kernel_tracepoint(lookup_capture_tracepoint, NULL);
+    
+    for (i = 0; i < ARRAY_SIZE(capture_tracepoints); i++) {
+        if (!capture_tracepoints[i].tp) {
+            printk(KERN_ERR "process_monitor: Tracepoint %s not found\n",
+                   capture_tracepoints[i].name);
+            unregister_tracepoint_backend();
+            return -ENOENT;
+        }
+        
+        ret = tracepoint_probe_register(capture_tracepoints[i].tp,
+                                        capture_tracepoints[i].probe, NULL);
+        if (ret < 0) {
+            printk(KERN_ERR "process_monitor: Failed to register tracepoint %s: %d\n",
+                   capture_tracepoints[i].name, ret);
+            unregister_tracepoint_backend();
+            return ret;
+        }
+        capture_tracepoints[i].registered = 1;
+    }
+    
     return 0;
 }
 
+static int register_capture_backend(void)
+{
+    int ret;
+    
+    if (strcmp(capture_backend, "kprobe") == 0) {
+        capture_mode = CAPTURE_KPROBE;
+    } else if (strcmp(capture_backend, "tracepoint") == 0) {
+        capture_mode = CAPTURE_TRACEPOINT;
+    } else {
+        printk(KERN_ERR "process_monitor: Unknown capture_backend '%s'\n", capture_backend);
+        return -EINVAL;
+    }
+    
+    if (capture_mode == CAPTURE_KPROBE)
+        ret = register_kprobe_backend();
+    else
+        ret = register_tracepoint_backend();
+    
+    return ret;
+}
+
+static void unregister_capture_backend(void)
+{
+    if (capture_mode == CAPTURE_KPROBE)
+        unregister_kprobe_backend();
+    else
+        unregister_tracepoint_backend();
+}
+
+static const char *kprobe_dispatch_name(struct kprobe *kp)
+{
+    if (kp->flags & KPROBE_FLAG_FTRACE)
+        return "ftrace";
+    if (kp->flags & KPROBE_FLAG_OPTIMIZED)
+        return "optimized";
+    return "int3";
+}
+
+static void show_capture_backend(struct seq_file *m)
+{
+    seq_printf(m, "\n=== Capture Backend ===\n");
+    seq_printf(m, "Mode: %s\n", capture_backend);
+    if (capture_mode == CAPTURE_KPROBE) {
+        seq_printf(m, "Fork kprobe: %s (%s)\n", kp_do_fork.symbol_name,
+                   kprobe_dispatch_name(&kp_do_fork));
+        seq_printf(m, "Exit kprobe: %s (%s)\n", kp_do_exit.symbol_name,
+                   kprobe_dispatch_name(&kp_do_exit));
+    }
+}
+
 static int process_monitor_show(struct seq_file *m, void *v)
 {
     struct process_record *record;
-    unsigned long flags;
     unsigned long uptime_jiffies;
     
     seq_printf(m, "=== Process Monitor Statistics ===\n");
     seq_printf(m, "Total Processes Created: %lu\n", stats.total_processes_created);
     seq_printf(m, "Total Processes Exited: %lu\n", stats.total_processes_exited);
+    seq_printf(m, "Total Execs: %lu\n", stats.total_execs);
     seq_printf(m, "Current Active Processes: %lu\n", stats.current_processes);
     seq_printf(m, "Peak Processes: %lu\n", stats.peak_processes);
     seq_printf(m, "Records in Memory: %d\n", record_count);
+    seq_printf(m, "Indexed Running Records: %d\n", atomic_read(&pid_index.nelems));
+    seq_printf(m, "Staging Events Dropped: %lu\n", staging_dropped_events());
+    seq_printf(m, "Record Allocation Failures: %lu\n", alloc_failures);
+    seq_printf(m, "Per-event Logging: %s (suppressed: %lu)\n",
+               verbose_events ? "ON" : "OFF", total_suppressed);
+    show_capture_backend(m);
     seq_printf(m, "\n=== Recent Process Records ===\n");
     seq_printf(m, "%-8s %-8s %-16s %-12s %-12s %-8s\n", 
                "PID", "PPID", "COMMAND", "START_TIME", "END_TIME", "STATUS");
     seq_printf(m, "------------------------------------------------------------------------\n");
     
-    spin_lock_irqsave(&process_lock, flags);
+    spin_lock(&process_lock);
     
     list_for_each_entry(record, &process_list, list) {
         uptime_jiffies = record->end_time ? record->end_time : jiffies;
@@ -153,7 +758,7 @@ static int process_monitor_show(struct seq_file *m, void *v)
                    record->status ? "RUNNING" : "EXITED");
     }
     
-    spin_unlock_irqrestore(&process_lock, flags);
+    spin_unlock(&process_lock);
     
     return 0;
 }
@@ -168,7 +773,6 @@ static ssize_t process_monitor_write(struct file *file, const char __user *buffe
 {
     char cmd[32];
     struct process_record *record, *tmp;
-    unsigned long flags;
     
     if (count >= sizeof(cmd))
         return -EINVAL;
@@ -179,17 +783,19 @@ static ssize_t process_monitor_write(struct file *file, const char __user *buffe
     cmd[count] = '\0';
     
     if (strncmp(cmd, "clear", 5) == 0) {
-        spin_lock_irqsave(&process_lock, flags);
+        spin_lock(&process_lock);
         
         list_for_each_entry_safe(record, tmp, &process_list, list) {
             list_del(&record->list);
-            kfree(record);
+            if (record->status == 1)
+                unindex_process_record(record);
+            mempool_free(record, record_pool);
         }
         
         memset(&stats, 0, sizeof(stats));
         record_count = 0;
         
-        spin_unlock_irqrestore(&process_lock, flags);
+        spin_unlock(&process_lock);
         
         printk(KERN_INFO "process_monitor: Statistics cleared\n");
     }
@@ -213,37 +819,51 @@ static int __init process_monitor_init(void)
     
     memset(&stats, 0, sizeof(stats));
     
+    ret = create_record_pool();
+    if (ret < 0) {
+        printk(KERN_ERR "process_monitor: Failed to create record cache\n");
+        return ret;
+    }
+    
+    ret = rhashtable_init(&pid_index, &pid_index_params);
+    if (ret < 0) {
+        printk(KERN_ERR "process_monitor: Failed to create pid index\n");
+        destroy_record_pool();
+        return ret;
+    }
+    
+    ret = alloc_staging_buffers();
+    if (ret < 0) {
+        printk(KERN_ERR "process_monitor: Failed to allocate staging buffers\n");
+        rhashtable_destroy(&pid_index);
+        destroy_record_pool();
+        return ret;
+    }
+    
     proc_entry = proc_create(PROC_NAME, 0666, NULL, &process_monitor_fops);
     if (!proc_entry) {
         printk(KERN_ERR "process_monitor: Failed to create proc entry\n");
+        free_staging_buffers();
+        rhashtable_destroy(&pid_index);
+        destroy_record_pool();
         return -ENOMEM;
     }
     
-    kp_do_fork.symbol_name = "_do_fork";
-    kp_do_fork.pre_handler = pre_handler_fork;
-    ret = register_kprobe(&kp_do_fork);
+    ret = register_capture_backend();
     if (ret < 0) {
-        printk(KERN_INFO "process_monitor: Trying alternative fork symbol\n");
-        kp_do_fork.symbol_name = "kernel_clone";
-        ret = register_kprobe(&kp_do_fork);
-        if (ret < 0) {
-            printk(KERN_ERR "process_monitor: Failed to register fork kprobe: %d\n", ret);
-            proc_remove(proc_entry);
-            return ret;
-        }
-    }
-    
-    kp_do_exit.symbol_name = "do_exit";
-    kp_do_exit.pre_handler = pre_handler_exit;
-    ret = register_kprobe(&kp_do_exit);
-    if (ret < 0) {
-        printk(KERN_ERR "process_monitor: Failed to register exit kprobe: %d\n", ret);
-        unregister_kprobe(&kp_do_fork);
         proc_remove(proc_entry);
+        free_staging_buffers();
+        rhashtable_destroy(&pid_index);
+        destroy_record_pool();
         return ret;
     }
     
-    printk(KERN_INFO "process_monitor: Module loaded successfully\n");
+    ratelimit_set_flags(&event_ratelimit, RATELIMIT_MSG_ON_RELEASE);
+    summary.start = jiffies;
+    queue_delayed_work(system_wq, &drain_work, msecs_to_jiffies(STAGING_DRAIN_INTERVAL_MS));
+    
+    printk(KERN_INFO "process_monitor: Module loaded successfully (capture backend: %s)\n",
+           capture_backend);
     printk(KERN_INFO "process_monitor: Use 'cat /proc/%s' to view statistics\n", PROC_NAME);
     printk(KERN_INFO "process_monitor: Use 'echo clear > /proc/%s' to clear statistics\n", PROC_NAME);
     
@@ -256,16 +876,21 @@ static void __exit process_monitor_exit(void)
     
     printk(KERN_INFO "process_monitor: Unloading Process Monitor Module\n");
     
-    unregister_kprobe(&kp_do_fork);
-    unregister_kprobe(&kp_do_exit);
+    unregister_capture_backend();
+    
+    cancel_delayed_work_sync(&drain_work);
+    free_staging_buffers();
     
     proc_remove(proc_entry);
     
     list_for_each_entry_safe(record, tmp, &process_list, list) {
         list_del(&record->list);
-        kfree(record);
+        mempool_free(record, record_pool);
     }
     
+    rhashtable_destroy(&pid_index);
+    destroy_record_pool();
+    
     printk(KERN_INFO "process_monitor: Module unloaded successfully\n");
 }
 